@@ -24,7 +24,7 @@ variations of the "T" command:
 
   <T ID ADDRESS SUBADDRESS>:   creates a new turnout ID, with specified ADDRESS and SUBADDRESS
                                if turnout ID already exists, it is updated with specificed ADDRESS and SUBADDRESS
-                               returns: <O> if successful and <X> if unsuccessful (e.g. out of memory)
+                               returns: <O> if successful and <X> if unsuccessful (e.g. table full, see MAX_TURNOUTS in DCCpp_Uno.h)
 
   <T ID>:                      deletes definition of turnout ID
                                returns: <O> if successful and <X> if unsuccessful (e.g. ID does not exist)
@@ -67,6 +67,7 @@ the directions of any Turnouts being monitored or controlled by a separate inter
 #include <EEPROM.h>
 #endif
 #include "Comm.h"
+#include "SortedTable.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -77,7 +78,7 @@ void Turnout::activate(int s){
   SerialCommand::parse(c);
 #ifdef EESTORE
   if(num>0)
-    EEPROM.put(num,data.tStatus);
+    EEStore::journal(EESTORE_TURNOUT|data.tStatus,data.id);
 #endif
   INTERFACE.print("<H");
   INTERFACE.print(data.id);
@@ -90,28 +91,19 @@ void Turnout::activate(int s){
 ///////////////////////////////////////////////////////////////////////////////
 
 Turnout* Turnout::get(int n){
-  Turnout *tt;
-  for(tt=firstTurnout;tt!=NULL && tt->data.id!=n;tt=tt->nextTurnout);
-  return(tt); 
+  return(SortedTable<Turnout>::get(turnouts,nTurnouts,n));
 }
 ///////////////////////////////////////////////////////////////////////////////
 
 void Turnout::remove(int n){
-  Turnout *tt,*pp;
-  
-  for(pp=tt=firstTurnout;tt!=NULL && tt->data.id!=n;pp=tt,tt=tt->nextTurnout);
+  Turnout *tt=get(n);
 
   if(tt==NULL){
     INTERFACE.print("<X>");
     return;
   }
   
-  if(tt==firstTurnout)
-    firstTurnout=tt->nextTurnout;
-  else
-    pp->nextTurnout=tt->nextTurnout;
-
-  free(tt);
+  SortedTable<Turnout>::remove(turnouts,nTurnouts,tt-turnouts);
 
   INTERFACE.print("<O>");
 }
@@ -121,12 +113,12 @@ void Turnout::remove(int n){
 void Turnout::show(int n){
   Turnout *tt;
 
-  if(firstTurnout==NULL){
+  if(nTurnouts==0){
     INTERFACE.print("<X>");
     return;
   }
     
-  for(tt=firstTurnout;tt!=NULL;tt=tt->nextTurnout){
+  for(tt=turnouts;tt<turnouts+nTurnouts;tt++){
     INTERFACE.print("<H");
     INTERFACE.print(tt->data.id);
     if(n==1){
@@ -182,8 +174,10 @@ void Turnout::load(){
   for(int i=0;i<EEStore::eeStore->data.nTurnouts;i++){
     EEPROM.get(EEStore::pointer(),data);  
     tt=create(data.id,data.address,data.subAddress);
-    tt->data.tStatus=data.tStatus;
-    tt->num=EEStore::pointer();
+    if(tt!=NULL){                                       // NULL if the table is full
+      tt->data.tStatus=data.tStatus;
+      tt->num=EEStore::pointer();
+    }
     EEStore::advance(sizeof(tt->data));
   }  
 #endif
@@ -195,14 +189,12 @@ void Turnout::store(){
 #ifdef EESTORE
   Turnout *tt;
   
-  tt=firstTurnout;
   EEStore::eeStore->data.nTurnouts=0;
   
-  while(tt!=NULL){
+  for(tt=turnouts;tt<turnouts+nTurnouts;tt++){
     tt->num=EEStore::pointer();
-    EEPROM.put(EEStore::pointer(),tt->data);
+    EEStore::put(EEStore::pointer(),tt->data);
     EEStore::advance(sizeof(tt->data));
-    tt=tt->nextTurnout;
     EEStore::eeStore->data.nTurnouts++;
   }
 #endif  
@@ -211,22 +203,20 @@ void Turnout::store(){
 
 Turnout *Turnout::create(int id, int add, int subAdd, int v){
   Turnout *tt;
+  int i=SortedTable<Turnout>::find(turnouts,nTurnouts,id);
   
-  if(firstTurnout==NULL){
-    firstTurnout=(Turnout *)calloc(1,sizeof(Turnout));
-    tt=firstTurnout;
-  } else if((tt=get(id))==NULL){
-    tt=firstTurnout;
-    while(tt->nextTurnout!=NULL)
-      tt=tt->nextTurnout;
-    tt->nextTurnout=(Turnout *)calloc(1,sizeof(Turnout));
-    tt=tt->nextTurnout;
-  }
-
-  if(tt==NULL){       // problem allocating memory
-    if(v==1)
-      INTERFACE.print("<X>");
-    return(tt);
+  if(i<nTurnouts && turnouts[i].data.id==id){
+    tt=&turnouts[i];                   // update existing entry
+  } else {
+    if(nTurnouts==MAX_TURNOUTS){            // table full
+      failures++;
+      if(v==1)
+        INTERFACE.print("<X>");
+      return(NULL);
+    }
+    tt=SortedTable<Turnout>::insert(turnouts,nTurnouts,i);
+    if(nTurnouts>highWater)
+      highWater=nTurnouts;
   }
   
   tt->data.id=id;
@@ -241,6 +231,9 @@ Turnout *Turnout::create(int id, int add, int subAdd, int v){
 
 ///////////////////////////////////////////////////////////////////////////////
 
-Turnout *Turnout::firstTurnout=NULL;
+Turnout Turnout::turnouts[MAX_TURNOUTS];
+int Turnout::nTurnouts=0;
+int Turnout::highWater=0;
+int Turnout::failures=0;
 
 
@@ -20,12 +20,17 @@ struct TurnoutData {
 };
 
 struct Turnout{
-  static Turnout *firstTurnout;
+  static Turnout turnouts[];         // sorted by id, MAX_TURNOUTS entries
+  static int nTurnouts;
+  static int highWater;              // most entries ever in use
+  static int failures;               // creates refused because the table was full
   int num;
   struct TurnoutData data;
-  Turnout *nextTurnout;
   void activate(int s);
   static void parse(char *c);
+  inline int key() {                 // for SortedTable
+      return data.id;
+  }
   static Turnout* get(int);
   static void remove(int);
   static void load();
@@ -23,6 +23,29 @@ Part of DCC++ BASE STATION for the Arduino
 
 #define MAX_MAIN_REGISTERS 100
 
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// DEFINE NUMBER OF MAIN TRACK POWER DISTRICTS (1-3, more than 1 only on the MEGA)
+//
+// District 1 is the main track output of the motor shield. Districts 2 and 3 get the
+// same DCC signal from timer 4 and timer 5 and each need an external booster with
+// its own enable pin and current sense (see DCCpp_Uno.h for the pins). A short in
+// one district only turns off that district.
+
+#define MAIN_DISTRICTS 1
+
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// DCC_GENERATOR_USART: Generate the DCC signals with USART 2 (Main, TXD2 pin 16) and
+//                      USART 3 (Prog, TXD3 pin 14) in Master SPI mode instead of with
+//                      timer 1 and timer 3. This needs one interrupt per two to four DCC
+//                      bits instead of one per bit. MEGA only. Connect the direction
+//                      inputs of the motor shield to pins 16 and 14 instead of 12 and 2.
+//                      Can not be combined with RAILCOM_CUTOUT, USE_TRIGGERPIN, more
+//                      than one main district or <J>.
+//
+//#define DCC_GENERATOR_USART
+
 /////////////////////////////////////////////////////////////////////////////////////
 //
 // DEFINE COMMUNICATIONS INTERFACE
@@ -75,9 +98,28 @@ Part of DCC++ BASE STATION for the Arduino
 // you may then use less MAX_MAIN_REGISTERS to compensate (at least on the UNO)
 //#define EESTORE
 //
+// Define to have the throttle settings (<t>) and the functions FL,F1-F12 (<f>) of up to
+// RESTORE_LOCOS registers saved in the EEPROM and sent again after power-up.  Changes
+// are saved at most every 30 seconds, 8 bytes of EEPROM per register.  Needs EESTORE.
+//#define RESTORE_LOCOS 8
+//
 // Define only of you need fancy config output in the beginning. This takes RAM and
 // you may then use less MAX_MAIN_REGISTERS to compensate (at least on the UNO)
 //#define SHOWCONFIG // to preserve SDRAM
+//
+// Define only if you want per register refresh statistics for the <U> command.
+// This takes 21 bytes RAM per register, so you may then use less MAX_MAIN_REGISTERS
+// to compensate (at least on the UNO)
+//#define REGISTER_STATS
+//
+// Define to keep a history of the track currents and the main track voltage for the
+// <h> command.  This takes about 1.2KB RAM on the MEGA and 180 bytes on the UNO.
+//#define HISTORY
+//
+// Define to keep only the packet bytes in the registers (6 instead of 8 bytes RAM per
+// register) and have the interrupt routine add checksum, start and end bits while the
+// packet is sent.  With this the MEGA has room for MAX_MAIN_REGISTERS of 250 and more.
+//#define COMPACT_REGISTERS
 
 /////////////////////////////////////////////////////////////////////////////////////
 //
@@ -102,11 +144,52 @@ Part of DCC++ BASE STATION for the Arduino
 /////////////////////////////////////////////////////////////////////////////////////
 //
 // RAILCOM_CUTOUT: If you want to generate a railcom cutout. Experimental!
+//                 Uses timer 2, on the UNO and the MEGA.
 //
 //#define RAILCOM_CUTOUT
+//
+// RAILCOM_CUTOUT_PROG: Generate the cutout on the programming track too. Needs
+//                 RAILCOM_CUTOUT. On the MEGA connect pin 10 to the brake input
+//                 of motor channel B (pin 8).
+//
+//#define RAILCOM_CUTOUT_PROG
+//
+// RAILCOM_RECEIVER: Read what the decoders send in the cutout from a RailCom detector
+//                   connected to RX1 (pin 19). Needs RAILCOM_CUTOUT, MEGA only.
+//                   <l> lists the locos heard of on the main track.
+//
+//#define RAILCOM_RECEIVER
 
 /////////////////////////////////////////////////////////////////////////////////////
 //
 // ACCESSORIES_REVERSED reverse the direction of all accessories
 //
 //#define ACCESSORIES_REVERSED
+//
+// ACCESSORY_STATE: Remember the last ACTIVATE sent with <a> (or <T>) for each of the
+//                  2048 accessory outputs, 256 bytes RAM. <N ADDRESS COUNT> reads
+//                  them back.
+//
+//#define ACCESSORY_STATE
+//
+// ACCESSORY_REFRESH: Every that many ms send the next accessory output that has got
+//                  an <a> since power-up its last state again, for decoders that
+//                  missed it. Another 256 bytes RAM. Needs ACCESSORY_STATE. Do not use
+//                  with decoders that pulse a coil on every packet.
+//
+//#define ACCESSORY_REFRESH 500
+//
+// ACCESSORY_QUEUE: Put the packets of <a> (and <T>) into a queue of that many packets,
+//                  9 bytes RAM each, which the main track interrupt routine sends in
+//                  between the loco packets, instead of into register 0.  Then loop()
+//                  only waits when the queue is full.
+// ACCESSORY_RATIO: Number of loco packets between two packets from the queue, 2 if not
+//                  defined.  Needs ACCESSORY_QUEUE.
+// ACCESSORY_PULSE: Follow every accessory packet by one that switches the same output
+//                  off again after that many ms (at most 250), for solenoid decoders
+//                  without a pulse time of their own.  The queue is sent in order, so
+//                  the next accessory waits for that.  Needs ACCESSORY_QUEUE.
+//
+//#define ACCESSORY_QUEUE 8
+//#define ACCESSORY_RATIO 2
+//#define ACCESSORY_PULSE 100
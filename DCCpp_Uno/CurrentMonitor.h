@@ -31,17 +31,16 @@ class CurrentMonitor {
 
   static long int sampleTime;
   byte signalpin;
-  byte currentpin;
+  byte channel;                   // of the Sampler
   byte power;
   int current;                    // Real (corrected) current in mA, range 1mA to ~ 30A.
   int conversionPromille;          // Percentvalue to get mA from internal 0-1023 value.
                                   // For a factor of 3 use 3000, for 1.5 use 1500
-  int vccPromille;
   int currentlimit;               // limit for this output in mA
   const char *msg;
   byte errors;
 
-  int vccCorrection();
+  unsigned int toMilliAmps(unsigned int);
 
 public:
   CurrentMonitor(byte, byte, int, const char *);
@@ -51,8 +50,13 @@ public:
   inline byte powerstatus() {
       return power;
   }
+  inline void setLimit(int limit) {
+      currentlimit=limit;
+  }
   unsigned int read();
+  unsigned int quiescent();
   unsigned int getCurrent();
+  void printPower(unsigned int);
 };
 
 #endif
@@ -42,6 +42,10 @@ Part of DCC++ BASE STATION for the Arduino
 
   #define ARDUINO_TYPE    "UNO"
 
+  #define MAX_TURNOUTS    16              // size of the turnout, sensor and output tables
+  #define MAX_SENSORS      8
+  #define MAX_OUTPUTS      8
+
   #define DCC_SIGNAL_PIN_MAIN 10          // Ardunio Uno  - uses OC1B
   #define DCC_SIGNAL_PIN_PROG 5           // Arduino Uno  - uses OC0B
 
@@ -51,12 +55,69 @@ Part of DCC++ BASE STATION for the Arduino
 
   #endif
 
+  #if MAIN_DISTRICTS != 1
+
+    #error CANNOT COMPILE - DCC++ FOR THE UNO HAS NO TIMERS LEFT FOR MORE THAN ONE MAIN DISTRICT - PLEASE SET MAIN_DISTRICTS TO 1 IN THE CONFIG FILE
+
+  #endif
+
+  #ifdef RAILCOM_RECEIVER
+
+    #error CANNOT COMPILE - DCC++ FOR THE UNO HAS NO USART LEFT FOR RAILCOM - PLEASE UNDEFINE RAILCOM_RECEIVER IN THE CONFIG FILE
+
+  #endif
+
+  #ifdef DCC_GENERATOR_USART
+
+    #error CANNOT COMPILE - DCC++ FOR THE UNO HAS NO USART LEFT FOR DCC SIGNALS - PLEASE UNDEFINE DCC_GENERATOR_USART IN THE CONFIG FILE
+
+  #endif
+
 #elif defined  ARDUINO_AVR_MEGA2560
 
   #define ARDUINO_TYPE    "MEGA"
 
+  #define MAX_TURNOUTS   200              // size of the turnout, sensor and output tables
+  #define MAX_SENSORS     64
+  #define MAX_OUTPUTS     64
+
+#ifdef DCC_GENERATOR_USART
+  #define DCC_SIGNAL_PIN_MAIN 16          // Arduino Mega - uses TXD2
+  #define DCC_SIGNAL_PIN_PROG 14          // Arduino Mega - uses TXD3
+
+  #if defined(RAILCOM_CUTOUT) || defined(USE_TRIGGERPIN) || MAIN_DISTRICTS != 1
+
+    #error CANNOT COMPILE - DCC_GENERATOR_USART DOES NOT SUPPORT RAILCOM_CUTOUT, USE_TRIGGERPIN OR MORE THAN ONE MAIN DISTRICT
+
+  #endif
+#else
   #define DCC_SIGNAL_PIN_MAIN 12          // Arduino Mega - uses OC1B
   #define DCC_SIGNAL_PIN_PROG 2           // Arduino Mega - uses OC3B
+#endif
+
+  #if MAIN_DISTRICTS > 1
+    #define DCC_SIGNAL_PIN_DISTRICT2 7      // Arduino Mega - uses OC4B
+    #define SIGNAL_ENABLE_PIN_DISTRICT2 22
+    #define CURRENT_MONITOR_PIN_DISTRICT2 A3
+  #endif
+  #if MAIN_DISTRICTS > 2
+    #define DCC_SIGNAL_PIN_DISTRICT3 45     // Arduino Mega - uses OC5B
+    #define SIGNAL_ENABLE_PIN_DISTRICT3 23
+    #define CURRENT_MONITOR_PIN_DISTRICT3 A4
+  #endif
+  #ifdef RAILCOM_CUTOUT_PROG
+    #define CUTOUT_PIN_PROG 10              // Arduino Mega - uses OC2A, connect to BRAKE_PIN_PROG
+  #endif
+  #if defined(RAILCOM_RECEIVER) && !defined(RAILCOM_CUTOUT)
+
+    #error CANNOT COMPILE - RAILCOM_RECEIVER NEEDS RAILCOM_CUTOUT - PLEASE DEFINE IT IN THE CONFIG FILE
+
+  #endif
+  #if MAIN_DISTRICTS < 1 || MAIN_DISTRICTS > 3
+
+    #error CANNOT COMPILE - PLEASE SET MAIN_DISTRICTS TO 1, 2 OR 3 IN THE CONFIG FILE
+
+  #endif
 
 #else
 
@@ -64,6 +125,40 @@ Part of DCC++ BASE STATION for the Arduino
 
 #endif
 
+#if defined(RAILCOM_CUTOUT_PROG) && !defined(RAILCOM_CUTOUT)
+
+  #error CANNOT COMPILE - RAILCOM_CUTOUT_PROG NEEDS RAILCOM_CUTOUT - PLEASE DEFINE IT IN THE CONFIG FILE
+
+#endif
+
+#if defined(RESTORE_LOCOS) && !defined(EESTORE)
+
+  #error CANNOT COMPILE - RESTORE_LOCOS NEEDS EESTORE - PLEASE DEFINE IT IN THE CONFIG FILE
+
+#endif
+
+#if defined(ACCESSORY_REFRESH) && !defined(ACCESSORY_STATE)
+
+  #error CANNOT COMPILE - ACCESSORY_REFRESH NEEDS ACCESSORY_STATE - PLEASE DEFINE IT IN THE CONFIG FILE
+
+#endif
+
+#if defined(ACCESSORY_PULSE) && !defined(ACCESSORY_QUEUE)
+
+  #error CANNOT COMPILE - ACCESSORY_PULSE NEEDS ACCESSORY_QUEUE - PLEASE DEFINE IT IN THE CONFIG FILE
+
+#endif
+
+#if defined(ACCESSORY_PULSE) && ACCESSORY_PULSE > 250
+
+  #error CANNOT COMPILE - ACCESSORY_PULSE CAN BE AT MOST 250 MS - PLEASE CHANGE IT IN THE CONFIG FILE
+
+#endif
+
+#if defined(ACCESSORY_QUEUE) && !defined(ACCESSORY_RATIO)
+#define ACCESSORY_RATIO 2                // loco packets between two packets from the queue, see Config.h
+#endif
+
 /////////////////////////////////////////////////////////////////////////////////////
 // SELECT MOTOR SHIELD
 /////////////////////////////////////////////////////////////////////////////////////
@@ -77,8 +172,8 @@ Part of DCC++ BASE STATION for the Arduino
   #define SIGNAL_ENABLE_PIN_PROG 11
 
 #ifdef RAILCOM_CUTOUT
-  #define BRAKE_PIN_MAIN 9
-// not used yet  #define BRAKE_PIN_PROG 8
+  #define BRAKE_PIN_MAIN 9                // is OC2B on the Mega
+  #define BRAKE_PIN_PROG 8
 #endif
 
   #define CURRENT_MONITOR_PIN_MAIN A0
@@ -99,7 +194,7 @@ Part of DCC++ BASE STATION for the Arduino
 #ifdef RAILCOM_CUTOUT
   DONT KNOW BRAKE PINS FOR THIS MOTOR SHIELD
   #define BRAKE_PIN_MAIN X
-// not used yet  #define BRAKE_PIN_PROG Y
+  #define BRAKE_PIN_PROG Y
 #endif
 
   #define CURRENT_MONITOR_PIN_MAIN A0
@@ -108,6 +203,12 @@ Part of DCC++ BASE STATION for the Arduino
   #define DIRECTION_MOTOR_CHANNEL_PIN_A 7
   #define DIRECTION_MOTOR_CHANNEL_PIN_B 8
 
+  #if MAIN_DISTRICTS > 1
+
+    #error CANNOT COMPILE - THE POLOLU MOTOR SHIELD USES THE PINS OF TIMER 4 - PLEASE SET MAIN_DISTRICTS TO 1 IN THE CONFIG FILE
+
+  #endif
+
 #else
 
   #error CANNOT COMPILE - PLEASE SELECT A PROPER MOTOR SHIELD TYPE
@@ -168,5 +269,17 @@ extern volatile unsigned long int tickCounter;  // instead of clock because we d
 class CurrentMonitor;
 extern CurrentMonitor mainMonitor;
 extern CurrentMonitor progMonitor;
+#if MAIN_DISTRICTS > 1
+extern CurrentMonitor district2Monitor;
+#endif
+#if MAIN_DISTRICTS > 2
+extern CurrentMonitor district3Monitor;
+#endif
 class VoltageMonitor;
 extern VoltageMonitor mainVoltageMonitor;
+#define DCC_JOIN_OFF       0                     // values of progTrackJoined, see DccTimerJoin
+#define DCC_JOIN_ACTIVE    1
+#define DCC_JOIN_REQUESTED 2
+extern volatile byte progTrackJoined;
+void joinProgTrack();
+void unjoinProgTrack();
@@ -148,6 +148,18 @@ DCC++ BASE STATION in split into multiple modules, each with its own header file
 
   PacketRegister:   contains methods to load, store, and update Packet Registers with DCC instructions
 
+  DccChannel:       contains the interrupt code that turns the Packet Registers into the DCC signal
+                    of one track, together with the timer configurations it can run on
+
+  RailCom:          contains methods to receive and decode what the decoders on the Main Track send
+                    in the RailCom cutout (Mega only)
+
+  Sampler:          contains the ADC interrupt that reads all analog inputs in the background and
+                    oversamples the Programming Track current
+
+  History:          contains methods to keep and report a history of the track currents and voltage
+                    (if HISTORY is defined in Config.h)
+
   CurrentMonitor:   contains methods to separately monitor and report the current drawn from CHANNEL A and
                     CHANNEL B of the Arduino Motor Shield's, and shut down power if a short-circuit overload
                     is detected
@@ -160,8 +172,14 @@ DCC++ BASE STATION in split into multiple modules, each with its own header file
 
   Outputs:          contains methods to configure one or more Arduino pins as an output for your own custom use
 
+  SortedTable:      contains the template that keeps the tables of turnouts, sensors and outputs sorted by id
+
   EEStore:          contains methods to store, update, and load various DCC settings and status
-                    (e.g. the states of all defined turnouts) in the EEPROM for recall after power-up
+                    (e.g. the states of all defined turnouts) in the EEPROM for recall after power-up,
+                    as snapshots protected by a CRC and a journal of the state changes since
+
+  EEQueue:          contains the EEPROM ready interrupt that writes the EEStore journal of turnout and
+                    output states in the background
 
 DCC++ BASE STATION is configured through the Config.h file that contains all user-definable parameters                    
 
@@ -175,16 +193,70 @@ DCC++ BASE STATION is configured through the Config.h file that contains all use
 #include "PacketRegister.h"
 #include "CurrentMonitor.h"
 #include "VoltageMonitor.h"
+#include "Sampler.h"
+#ifdef HISTORY
+#include "History.h"
+#endif
 #include "Sensor.h"
 #include "SerialCommand.h"
 #include "Accessories.h"
 #ifdef EESTORE
 #include "EEStore.h"
 #endif
+#include "DccChannel.h"
+#include "RailCom.h"
 #include "Comm.h"
 
 void showConfiguration();
 
+// SELECT THE TIMERS AND FEATURES OF THE MAIN AND PROGRAMMING TRACK SIGNALS
+
+#ifdef RAILCOM_CUTOUT
+  #define MAIN_RAILCOM DCC_CHANNEL_RAILCOM
+#else
+  #define MAIN_RAILCOM 0
+#endif
+#ifdef RAILCOM_CUTOUT_PROG
+  #define PROG_RAILCOM DCC_CHANNEL_RAILCOM_PROG
+#else
+  #define PROG_RAILCOM 0
+#endif
+#ifdef USE_TRIGGERPIN
+  #define MAIN_TRIGGER DCC_CHANNEL_TRIGGER
+#else
+  #define MAIN_TRIGGER 0
+#endif
+#ifdef ACCESSORY_QUEUE
+  #define MAIN_ACCESSORIES DCC_CHANNEL_ACCESSORIES
+#else
+  #define MAIN_ACCESSORIES 0
+#endif
+
+#ifdef DCC_GENERATOR_USART
+// the USART structs have the same begin(), reset() and enableInterrupt() as the timers
+typedef DccUsart2 MainTimer;
+typedef DccUsart3 ProgTimer;
+
+typedef DccUsartChannel<MainTimer,PREAMBLE_MAIN,DCC_CHANNEL_TICKCOUNT|MAIN_ACCESSORIES> MainChannel;
+typedef DccUsartChannel<ProgTimer,PREAMBLE_PROG,0> ProgChannel;
+#else
+#if MAIN_DISTRICTS == 3
+typedef DccTimerPair<DccTimer1, DccTimerPair<DccTimer4, DccTimer5> > MainTimer;
+#elif MAIN_DISTRICTS == 2
+typedef DccTimerPair<DccTimer1, DccTimer4> MainTimer;
+#else
+typedef DccTimer1 MainTimer;
+#endif
+#ifdef ARDUINO_AVR_UNO
+typedef DccTimer0 ProgTimer;
+#else
+typedef DccTimer3 ProgTimer;
+#endif
+
+typedef DccChannel<DccTimerJoin<MainTimer,ProgTimer>,PREAMBLE_MAIN,DCC_CHANNEL_TICKCOUNT|MAIN_RAILCOM|MAIN_TRIGGER|MAIN_ACCESSORIES> MainChannel;
+typedef DccChannel<ProgTimer,PREAMBLE_PROG,PROG_RAILCOM> ProgChannel;
+#endif
+
 // SET UP COMMUNICATIONS INTERFACE - FOR STANDARD SERIAL, NOTHING NEEDS TO BE DONE
 
 #if COMM_TYPE == 1
@@ -195,23 +267,36 @@ void showConfiguration();
 // NEXT DECLARE GLOBAL OBJECTS TO PROCESS AND STORE DCC PACKETS AND MONITOR TRACK CURRENTS.
 // NOTE REGISTER LISTS MUST BE DECLARED WITH "VOLATILE" QUALIFIER TO ENSURE THEY ARE PROPERLY UPDATED BY INTERRUPT ROUTINES
 
-volatile RegisterList mainRegs(MAX_MAIN_REGISTERS);    // create list of registers for MAX_MAIN_REGISTER Main Track Packets
-volatile RegisterList progRegs(2);                     // create a shorter list of only two registers for Program Track Packets
+volatile RegisterList<MAX_MAIN_REGISTERS> mainRegs;    // create list of registers for MAX_MAIN_REGISTER Main Track Packets
+volatile RegisterList<2> progRegs;                     // create a shorter list of only two registers for Program Track Packets
 
 volatile unsigned long int tickCounter = 0;
 volatile unsigned long int sampleTime = 0;
+volatile byte progTrackJoined = DCC_JOIN_OFF;
+#ifdef RAILCOM_CUTOUT
+volatile byte dccCutoutState = 0;
+#endif
 
 //////////////////////////////////////////////////////////////////////////////
 // Create the global voltage and current monitors
 //////////////////////////////////////////////////////////////////////////////
 
-VoltageMonitor mainVoltageMonitor(SIGNAL_ENABLE_PIN_MAIN, VOLTAGE_MONITOR_PIN_MAIN);  // create monitor for voltage on Main Track
+VoltageMonitor mainVoltageMonitor(SIGNAL_ENABLE_PIN_MAIN, SAMPLER_VOLTAGE);  // create monitor for voltage on Main Track
 
 // create monitor for current on Main Track
-CurrentMonitor mainMonitor(SIGNAL_ENABLE_PIN_MAIN, CURRENT_MONITOR_PIN_MAIN, MOTOR_SHIELD_CURRENT_LIMIT, "MAIN");
+CurrentMonitor mainMonitor(SIGNAL_ENABLE_PIN_MAIN, SAMPLER_MAIN, MOTOR_SHIELD_CURRENT_LIMIT, "MAIN");
 
 // create monitor for current on Program Track. 250mA is the NMRA value for prog tracks.
-CurrentMonitor progMonitor(SIGNAL_ENABLE_PIN_PROG, CURRENT_MONITOR_PIN_PROG, 250, "PROG");
+#define PROG_CURRENT_LIMIT 250
+CurrentMonitor progMonitor(SIGNAL_ENABLE_PIN_PROG, SAMPLER_PROG, PROG_CURRENT_LIMIT, "PROG");
+
+// create monitors for current on the additional Main Track districts
+#if MAIN_DISTRICTS > 1
+CurrentMonitor district2Monitor(SIGNAL_ENABLE_PIN_DISTRICT2, SAMPLER_DISTRICT2, MOTOR_SHIELD_CURRENT_LIMIT, "DIST2");
+#endif
+#if MAIN_DISTRICTS > 2
+CurrentMonitor district3Monitor(SIGNAL_ENABLE_PIN_DISTRICT3, SAMPLER_DISTRICT3, MOTOR_SHIELD_CURRENT_LIMIT, "DIST3");
+#endif
 
 ///////////////////////////////////////////////////////////////////////////////
 // MAIN ARDUINO LOOP
@@ -227,9 +312,33 @@ void loop(){
     mainVoltageMonitor.check();
     mainMonitor.check();
     progMonitor.check();
+    RegisterListBase::progSessionCheck();  // a short on the Programming Track ends a <G 1> session
+#if MAIN_DISTRICTS > 1
+    district2Monitor.check();
+#endif
+#if MAIN_DISTRICTS > 2
+    district3Monitor.check();
+#endif
+#ifdef HISTORY
+    History::sample(mainMonitor.getCurrent(), progMonitor.getCurrent(), mainVoltageMonitor.getMilliVolts());
+#endif
   }
 
   Sensor::check();    // check sensors for activate/de-activate
+
+  Sampler::check();   // update the Vcc correction from the background bandgap readings
+
+#ifdef RESTORE_LOCOS
+  EEStore::saveLocos();  // write changed throttle settings and functions to the EEPROM now and then
+#endif
+
+#ifdef ACCESSORY_REFRESH
+  mainRegs.refreshAccessory();  // send one remembered accessory state again now and then
+#endif
+
+#ifdef RAILCOM_RECEIVER
+  RailCom::check();   // decode what was received in the last RailCom cutout
+#endif
   
 } // loop
 
@@ -247,10 +356,6 @@ void setup(){
     digitalWrite(SDCARD_CS,HIGH);     // Deselect the SD card
   #endif
 
-#ifdef EESTORE
-  EEStore::init();                                          // initialize and load Turnout and Sensor definitions stored in EEPROM
-#endif
-
   pinMode(CURRENT_MONITOR_PIN_MAIN, INPUT);
   pinMode(CURRENT_MONITOR_PIN_PROG, INPUT);
   pinMode(VOLTAGE_MONITOR_PIN_MAIN, INPUT);
@@ -280,22 +385,10 @@ void setup(){
 #endif
 
   // CONFIGURE TIMER_1 TO OUTPUT 50% DUTY CYCLE DCC SIGNALS ON OC1B INTERRUPT PINS
+  // (OR USART_2 ON TXD2 IF DCC_GENERATOR_USART IS DEFINED)
   
   // Direction Pin for Motor Shield Channel A - MAIN OPERATIONS TRACK
-  // Controlled by Arduino 16-bit TIMER 1 / OC1B Interrupt Pin
-  // Values for 16-bit OCR1A and OCR1B registers calibrated for 1:1 prescale at 16 MHz clock frequency
-  // Resulting waveforms are 200 microseconds for a ZERO bit and 116 microseconds for a ONE bit with exactly 50% duty cycle
-
-  // Internal tick counter, one tick is 4 microseconds
-  // tickCounter is increased with that much ticks when DCC 1/0 is generated
-  #define DCC_ZERO_TICKS 50
-  #define DCC_ONE_TICKS  29
-
-  #define DCC_ZERO_BIT_TOTAL_DURATION_TIMER1 3199
-  #define DCC_ZERO_BIT_PULSE_DURATION_TIMER1 1599
-
-  #define DCC_ONE_BIT_TOTAL_DURATION_TIMER1 1855
-  #define DCC_ONE_BIT_PULSE_DURATION_TIMER1 927
+  // Controlled by Arduino 16-bit TIMER 1 / OC1B Interrupt Pin (see DccChannel.h)
 
   pinMode(DIRECTION_MOTOR_CHANNEL_PIN_A,INPUT);      // ensure this pin is not active! Direction will be controlled by DCC SIGNAL instead (below)
   digitalWrite(DIRECTION_MOTOR_CHANNEL_PIN_A,LOW);
@@ -303,110 +396,66 @@ void setup(){
   pinMode(DCC_SIGNAL_PIN_MAIN, OUTPUT);      // THIS ARDUINO OUTPUT PIN MUST BE PHYSICALLY CONNECTED TO THE PIN FOR DIRECTION-A OF MOTOR CHANNEL-A
 
 #ifdef RAILCOM_CUTOUT
-  pinMode(BRAKE_PIN_MAIN, OUTPUT);
-  digitalWrite(BRAKE_PIN_MAIN, LOW);
+  DccCutoutTimer2::begin();                 // timer 2 places the edges of the RailCom cutouts
+  DccCutoutMain::begin();
+#endif
+#ifdef RAILCOM_CUTOUT_PROG
+  DccCutoutProg::begin();
+#endif
+#ifdef RAILCOM_RECEIVER
+  RailCom::begin();
 #endif
 
-  bitSet(TCCR1A,WGM10);     // set Timer 1 to FAST PWM, with TOP=OCR1A
-  bitSet(TCCR1A,WGM11);
-  bitSet(TCCR1B,WGM12);
-  bitSet(TCCR1B,WGM13);
+#if MAIN_DISTRICTS > 1
+  pinMode(DCC_SIGNAL_PIN_DISTRICT2, OUTPUT); // CONNECT TO THE DIRECTION INPUT OF THE BOOSTER FOR DISTRICT 2
+  pinMode(SIGNAL_ENABLE_PIN_DISTRICT2, OUTPUT);
+  pinMode(CURRENT_MONITOR_PIN_DISTRICT2, INPUT);
+#endif
+#if MAIN_DISTRICTS > 2
+  pinMode(DCC_SIGNAL_PIN_DISTRICT3, OUTPUT); // CONNECT TO THE DIRECTION INPUT OF THE BOOSTER FOR DISTRICT 3
+  pinMode(SIGNAL_ENABLE_PIN_DISTRICT3, OUTPUT);
+  pinMode(CURRENT_MONITOR_PIN_DISTRICT3, INPUT);
+#endif
 
-  bitSet(TCCR1A,COM1B1);    // set Timer 1, OC1B (pin 10/UNO, pin 12/MEGA) to inverting toggle (actual direction is arbitrary)
-  bitSet(TCCR1A,COM1B0);
+  Sampler::begin();                         // from now on the ADC interrupt reads all analog inputs
 
-  bitClear(TCCR1B,CS12);    // set Timer 1 prescale=1
-  bitClear(TCCR1B,CS11);
-  bitSet(TCCR1B,CS10);
-    
-  OCR1A=DCC_ONE_BIT_TOTAL_DURATION_TIMER1;
-  OCR1B=DCC_ONE_BIT_PULSE_DURATION_TIMER1;
+  DCC_TIMERS_HALT();                        // configure all timers of the main track while they are stopped
+  MainTimer::begin();                       // and let them start in phase
+  MainTimer::reset();
+  DCC_TIMERS_START();
   
   pinMode(SIGNAL_ENABLE_PIN_MAIN,OUTPUT);   // master enable for motor channel A
 
-  mainRegs.loadPacket(1,RegisterList::idlePacket,2,0);    // load idle packet into register 1    
+  mainRegs.loadPacket(1,RegisterListBase::idlePacket,2,0);    // load idle packet into register 1    
       
-  bitSet(TIMSK1,OCIE1B);    // enable interrupt vector for Timer 1 Output Compare B Match (OCR1B)    
+  MainTimer::enableInterrupt();
 
   // CONFIGURE EITHER TIMER_0 (UNO) OR TIMER_3 (MEGA) TO OUTPUT 50% DUTY CYCLE DCC SIGNALS ON OC0B (UNO) OR OC3B (MEGA) INTERRUPT PINS
-  
-#ifdef ARDUINO_AVR_UNO      // Configuration for UNO
+  // (OR USART_3 ON TXD3 IF DCC_GENERATOR_USART IS DEFINED)
   
   // Directon Pin for Motor Shield Channel B - PROGRAMMING TRACK
-  // Controlled by Arduino 8-bit TIMER 0 / OC0B Interrupt Pin
-  // Values for 8-bit OCR0A and OCR0B registers calibrated for 1:64 prescale at 16 MHz clock frequency
-  // Resulting waveforms are 200 microseconds for a ZERO bit and 116 microseconds for a ONE bit with as-close-as-possible to 50% duty cycle
-
-  #define DCC_ZERO_BIT_TOTAL_DURATION_TIMER0 49
-  #define DCC_ZERO_BIT_PULSE_DURATION_TIMER0 24
+  // Controlled by Arduino 8-bit TIMER 0 / OC0B (UNO) or 16-bit TIMER 3 / OC3B (MEGA) Interrupt Pin (see DccChannel.h)
 
-  #define DCC_ONE_BIT_TOTAL_DURATION_TIMER0 28
-  #define DCC_ONE_BIT_PULSE_DURATION_TIMER0 14
-  
   pinMode(DIRECTION_MOTOR_CHANNEL_PIN_B,INPUT);      // ensure this pin is not active! Direction will be controlled by DCC SIGNAL instead (below)
   digitalWrite(DIRECTION_MOTOR_CHANNEL_PIN_B,LOW);
 
   pinMode(DCC_SIGNAL_PIN_PROG,OUTPUT);      // THIS ARDUINO OUTPUT PIN MUST BE PHYSICALLY CONNECTED TO THE PIN FOR DIRECTION-B OF MOTOR CHANNEL-B
 
-  bitSet(TCCR0A,WGM00);     // set Timer 0 to FAST PWM, with TOP=OCR0A
-  bitSet(TCCR0A,WGM01);
-  bitSet(TCCR0B,WGM02);
-     
-  bitSet(TCCR0A,COM0B1);    // set Timer 0, OC0B (pin 5) to inverting toggle (actual direction is arbitrary)
-  bitSet(TCCR0A,COM0B0);
-
-  bitClear(TCCR0B,CS02);    // set Timer 0 prescale=64
-  bitSet(TCCR0B,CS01);
-  bitSet(TCCR0B,CS00);
-
-  OCR0A=DCC_ONE_BIT_TOTAL_DURATION_TIMER0;
-  OCR0B=DCC_ONE_BIT_PULSE_DURATION_TIMER0;
+  ProgTimer::begin();
   
   pinMode(SIGNAL_ENABLE_PIN_PROG,OUTPUT);   // master enable for motor channel B
 
-  progRegs.loadPacket(1,RegisterList::idlePacket,2,0);    // load idle packet into register 1    
+  progRegs.loadPacket(1,RegisterListBase::idlePacket,2,0);    // load idle packet into register 1    
       
-  bitSet(TIMSK0,OCIE0B);    // enable interrupt vector for Timer 0 Output Compare B Match (OCR0B)
+  ProgTimer::enableInterrupt();
 
-#else      // Configuration for MEGA
+  // THE DCC SIGNALS RUN NOW, SO THE DECODERS GET IDLE PACKETS WHILE THE EEPROM IS READ
 
-  // Directon Pin for Motor Shield Channel B - PROGRAMMING TRACK
-  // Controlled by Arduino 16-bit TIMER 3 / OC3B Interrupt Pin
-  // Values for 16-bit OCR3A and OCR3B registers calibrated for 1:1 prescale at 16 MHz clock frequency
-  // Resulting waveforms are 200 microseconds for a ZERO bit and 116 microseconds for a ONE bit with exactly 50% duty cycle
-
-  #define DCC_ZERO_BIT_TOTAL_DURATION_TIMER3 3199
-  #define DCC_ZERO_BIT_PULSE_DURATION_TIMER3 1599
-
-  #define DCC_ONE_BIT_TOTAL_DURATION_TIMER3 1855
-  #define DCC_ONE_BIT_PULSE_DURATION_TIMER3 927
-
-  pinMode(DIRECTION_MOTOR_CHANNEL_PIN_B,INPUT);      // ensure this pin is not active! Direction will be controlled by DCC SIGNAL instead (below)
-  digitalWrite(DIRECTION_MOTOR_CHANNEL_PIN_B,LOW);
-
-  pinMode(DCC_SIGNAL_PIN_PROG,OUTPUT);      // THIS ARDUINO OUTPUT PIN MUST BE PHYSICALLY CONNECTED TO THE PIN FOR DIRECTION-B OF MOTOR CHANNEL-B
-
-  bitSet(TCCR3A,WGM30);     // set Timer 3 to FAST PWM, with TOP=OCR3A
-  bitSet(TCCR3A,WGM31);
-  bitSet(TCCR3B,WGM32);
-  bitSet(TCCR3B,WGM33);
-
-  bitSet(TCCR3A,COM3B1);    // set Timer 3, OC3B (pin 2) to inverting toggle (actual direction is arbitrary)
-  bitSet(TCCR3A,COM3B0);
-
-  bitClear(TCCR3B,CS32);    // set Timer 3 prescale=1
-  bitClear(TCCR3B,CS31);
-  bitSet(TCCR3B,CS30);
-    
-  OCR3A=DCC_ONE_BIT_TOTAL_DURATION_TIMER3;
-  OCR3B=DCC_ONE_BIT_PULSE_DURATION_TIMER3;
-  
-  pinMode(SIGNAL_ENABLE_PIN_PROG,OUTPUT);   // master enable for motor channel B
-
-  progRegs.loadPacket(1,RegisterList::idlePacket,2,0);    // load idle packet into register 1    
-      
-  bitSet(TIMSK3,OCIE3B);    // enable interrupt vector for Timer 3 Output Compare B Match (OCR3B)    
-  
+#ifdef EESTORE
+  EEStore::init();                                          // initialize and load Turnout and Sensor definitions stored in EEPROM
+#endif
+#ifdef RESTORE_LOCOS
+  EEStore::restoreLocos(&mainRegs);                         // and send the last throttle settings and functions again
 #endif
 
 } // setup
@@ -415,11 +464,9 @@ void setup(){
 // DEFINE THE INTERRUPT LOGIC THAT GENERATES THE DCC SIGNAL
 ///////////////////////////////////////////////////////////////////////////////
 
-// The code below will be called every time an interrupt is triggered on OCNB, where N can be 0 or 1. 
-// It is designed to read the current bit of the current register packet and
-// updates the OCNA and OCNB counters of Timer-N to values that will either produce
-// a long (200 microsecond) pulse, or a short (116 microsecond) pulse, which respectively represent
-// DCC ZERO and DCC ONE bits.
+// The interrupt code itself is in DccChannel.h.  It is instantiated once per
+// channel so that every channel gets its own copy with all timer registers,
+// the preamble length and the optional features as constants.
 
 // These are hardware-driven interrupts that will be called automatically when triggered regardless of what
 // DCC++ BASE STATION was otherwise processing.  But once inside the interrupt, all other interrupt routines are temporarily disabled.
@@ -431,104 +478,87 @@ void setup(){
 // interrupt code completes and can be called again.
 
 // A significant portion of this entire program is designed to do as much of the heavy processing of creating a properly-formed
-// DCC bit stream upfront, so that the interrupt code below can be as simple and efficient as possible.
-
-// Note that we need to create two very similar copies of the code --- one for the Main Track OC1B interrupt and one for the
-// Programming Track OCOB interrupt.  But rather than create a generic function that incurrs additional overhead, we create a macro
-// that can be invoked with proper paramters for each interrupt.  This slightly increases the size of the code base by duplicating
-// some of the logic for each interrupt, but saves additional time.
+// DCC bit stream upfront, so that the interrupt code can be as simple and efficient as possible.
 
 // Measurement gives that the interrupt code takes mostly 8.4us, sometimes as short a 5.8us and at worst 12.2us.
 
-// THE INTERRUPT CODE MACRO:  R=REGISTER LIST (mainRegs or progRegs)
-//                            N=TIMER (0 or 1)
-//                            PALEN=PREAMBLELENGTH (14 or 16 for RailCom om Main, 22 on Prog)
-//                            INCTICKOUNT Inserts (!) code that increases the tick counter, use only on ONE interrupt routine
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wunused-value"
-// optimize time critical stuff harder 
+// optimize time critical stuff harder: interrupt() is inlined into the ISR bodies, so
+// they have to be in the -O3 region as well, not only the templates in DccChannel.h
 #pragma GCC push_options
 #pragma GCC optimize ("-O3")
 
-#define DCC_SIGNAL(R,N,PALEN,INCTICKCOUNT) \
-  if(R.currentBit==(R.currentReg->nBits)+PALEN) { /* IF no more bits in this DCC Packet */ \
-    R.packetsTransmitted++;                  /* One more packet out 100% */ \
-    R.currentBit=0;                          /*   reset current bit pointer and determine which Register and Packet to process next--- */ \
-    if(R.nRepeat>0 && R.currentReg==R.reg) { /*   IF current Register is first Register AND should be repeated */ \
-      R.nRepeat--;                           /*     decrement repeat count; result is this same Packet will be repeated */ \
-    } else if(R.nextReg!=NULL){              /*   ELSE IF another Register has been updated */ \
-      R.currentReg=R.nextReg;                /*     update currentReg to nextReg */ \
-      R.nextReg=NULL;                        /*     reset nextReg to NULL */ \
-    } else{                                  /*   ELSE simply move to next Register */ \
-      if(R.currentReg==R.maxLoadedReg)       /*     BUT IF this is last Register loaded */ \
-        R.currentReg=R.reg;                  /*       first reset currentReg to base Register, THEN */ \
-      R.currentReg++;                        /* increment current Register (note this logic causes Register[0] to be skipped when simply cycling through all Registers) */ \
-    }                                        /* END-ELSE */ \
-                                             /* HERE currentReg, activePacket, and currentBit should now be properly set to point to next DCC bit */ \
-                                             /* Look at next packet */ \
-    if((R.currentReg->buf)[6] & 0x01) {      /* IF invalid flag is set skip */   \
-      if(R.currentReg==R.maxLoadedReg)       /*     BUT IF this is last Register loaded */ \
-        R.currentReg=R.reg;                  /*       first reset currentReg to base Register, THEN */ \
-      R.currentReg++;                        /* jump to next register */ \
-    }                                                              \
-  }                                          /* END-BIG-IF */ \
-                                                                                                                 \
-  if(R.currentBit < PALEN || ( (R.currentReg->buf)[(R.currentBit-PALEN)/8] & R.bitMask[(R.currentBit-PALEN)%8] )) {  /* IF bit is a ONE */ \
-    OCR ## N ## A=DCC_ONE_BIT_TOTAL_DURATION_TIMER ## N;                /*   set OCRA for timer N to full cycle duration of DCC ONE bit */ \
-    OCR ## N ## B=DCC_ONE_BIT_PULSE_DURATION_TIMER ## N;                /*   set OCRB for timer N to half cycle duration of DCC ONE but */ \
-    INCTICKCOUNT DCC_ONE_TICKS;                                                                                                            \
-  } else {                                                              /* ELSE it is a ZERO */ \
-    OCR ## N ## A=DCC_ZERO_BIT_TOTAL_DURATION_TIMER ## N;               /*   set OCRA for timer N to full cycle duration of DCC ZERO bit */ \
-    OCR ## N ## B=DCC_ZERO_BIT_PULSE_DURATION_TIMER ## N;               /*   set OCRB for timer N to half cycle duration of DCC ZERO bit */ \
-    INCTICKCOUNT DCC_ZERO_TICKS;                                                                                                            \
-  }                                                                     /* END-ELSE */ \
-                                                                                       \
-  R.currentBit++;                                                       /* point to next bit in current Packet */  
-  
-///////////////////////////////////////////////////////////////////////////////
-
-// NOW USE THE ABOVE MACRO TO CREATE THE CODE FOR EACH INTERRUPT
+#ifdef DCC_GENERATOR_USART  // Configuration for MEGA with USART signal generator
+ISR(USART2_UDRE_vect){      // set interrupt service for Data Register Empty of USART-2 which flips direction bit of Motor Shield Channel A controlling Main Track
+  MainChannel::interrupt(mainRegs);
+}
 
+ISR(USART3_UDRE_vect){      // set interrupt service for Data Register Empty of USART-3 which flips direction bit of Motor Shield Channel B controlling Prog Track
+  ProgChannel::interrupt(progRegs);
+}
+#else
 ISR(TIMER1_COMPB_vect){     // set interrupt service for OCR1B of TIMER-1 which flips direction bit of Motor Shield Channel A controlling Main Track
-#ifdef RAILCOM_CUTOUT
-  if (mainRegs.currentBit == 1) {                     // Start RailCom cutout
-    digitalWriteFast(BRAKE_PIN_MAIN, HIGH);
-  }
-#endif
-#ifdef USE_TRIGGERPIN
-#ifndef USE_TRIGGERPIN_PER_BIT
-#define TRIGGERBIT 1                                  // middle of first preamble bit (must match below)
-  if (mainRegs.currentBit == TRIGGERBIT)
-#endif
-     digitalWriteFast(TRIGGERPIN,HIGH);
-#endif
-#ifdef RAILCOM_CUTOUT
-  if (mainRegs.currentBit == 5) {                     // End RailCom cutout
-    digitalWriteFast(BRAKE_PIN_MAIN, LOW);
-  }
-#endif
-  DCC_SIGNAL(mainRegs,1,PREAMBLE_MAIN,tickCounter+=)  // Call macro above
-#ifdef USE_TRIGGERPIN
-#ifndef USE_TRIGGERPIN_PER_BIT
-  if (mainRegs.currentBit == (TRIGGERBIT + 1))        // currentBit was incremented in the macro
-#endif
-    digitalWriteFast(TRIGGERPIN,LOW);
-#endif
+  MainChannel::interrupt(mainRegs);
 }
 
 #ifdef ARDUINO_AVR_UNO      // Configuration for UNO
-ISR(TIMER0_COMPB_vect){     // set interrupt service for OCR1B of TIMER-0 which flips direction bit of Motor Shield Channel B controlling Prog Track
-  DCC_SIGNAL(progRegs,0,PREAMBLE_PROG,/* nothing */)
+ISR(TIMER0_COMPB_vect){     // set interrupt service for OCR0B of TIMER-0 which flips direction bit of Motor Shield Channel B controlling Prog Track
+  ProgChannel::interrupt(progRegs);
 }
 #else                       // Configuration for MEGA
 ISR(TIMER3_COMPB_vect){     // set interrupt service for OCR3B of TIMER-3 which flips direction bit of Motor Shield Channel B controlling Prog Track
-  DCC_SIGNAL(progRegs,3,PREAMBLE_PROG,/* nothing */)
+  ProgChannel::interrupt(progRegs);
+}
+#endif
+#endif
+
+#ifdef RAILCOM_CUTOUT
+ISR(TIMER2_COMPB_vect){     // set interrupt service for OCR2B of TIMER-2 which starts and ends the RailCom cutout on the Main Track
+  DccCutoutMain::compareMatch();
+}
+#endif
+#ifdef RAILCOM_CUTOUT_PROG
+ISR(TIMER2_COMPA_vect){     // set interrupt service for OCR2A of TIMER-2 which starts and ends the RailCom cutout on the Prog Track
+  DccCutoutProg::compareMatch();
 }
 #endif
 
 // pop the -O3
 #pragma GCC pop_options
-#pragma GCC diagnostic pop
+
+///////////////////////////////////////////////////////////////////////////////
+// JOIN THE PROGRAMMING TRACK TO THE MAIN TRACK
+///////////////////////////////////////////////////////////////////////////////
+
+// While joined the programming track timer does not interrupt, instead the main track
+// interrupt loads it together with the main track timer(s) (see DccTimerJoin).  The
+// programming track then is just another district and gets the main track current limit.
+// The USART signal generator can not do this, there <J 1> is ignored.
+
+void joinProgTrack(){
+#ifndef DCC_GENERATOR_USART
+  if(progTrackJoined!=DCC_JOIN_OFF)
+    return;
+  ProgTimer::disableInterrupt();
+  progTrackJoined=DCC_JOIN_REQUESTED;
+  while(progTrackJoined==DCC_JOIN_REQUESTED);  // busy wait, done with the next main track bit
+  progMonitor.setLimit(MOTOR_SHIELD_CURRENT_LIMIT);
+#endif
+}
+
+void unjoinProgTrack(){
+  if(progTrackJoined==DCC_JOIN_OFF)
+    return;
+  progMonitor.setLimit(PROG_CURRENT_LIMIT);
+  progTrackJoined=DCC_JOIN_OFF;
+  progRegs.currentBit=0;                       // start over with a full preamble
+#ifdef COMPACT_REGISTERS
+  progRegs.lookIndex=0;                        // and the packet from its first byte, as nextBit() does
+  progRegs.lookBits=0;
+  progRegs.look=0;
+  progRegs.checksum=0;
+#endif
+  ProgTimer::enableInterrupt();
+}
 
 ///////////////////////////////////////////////////////////////////////////////
 // PRINT CONFIGURATION INFO TO SERIAL PORT REGARDLESS OF INTERFACE TYPE
@@ -575,6 +605,7 @@ void showConfiguration(){
   Serial.print(CURRENT_MONITOR_PIN_PROG);
 
 #ifdef EESTORE
+  EEStore::init();                          // setup() has not loaded it yet
   Serial.print("\n\nNUM TURNOUTS: ");
   Serial.print(EEStore::eeStore->data.nTurnouts);
   Serial.print("\n     SENSORS: ");
@@ -0,0 +1,887 @@
+/**********************************************************************
+
+DccChannel.h
+COPYRIGHT (c) 2013-2016 Gregg E. Berman
+              2016-2020 Harald Barth
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+#ifndef DccChannel_h
+#define DccChannel_h
+
+#include "Arduino.h"
+#include "digitalWriteFast.h"
+#include "DCCpp_Uno.h"
+#include "PacketRegister.h"
+#include "RailCom.h"
+
+// Internal tick counter, one tick is 4 microseconds
+// tickCounter is increased with that much ticks when DCC 1/0 is generated
+#define DCC_ZERO_TICKS 50
+#define DCC_ONE_TICKS  29
+
+// Features that can be compiled into a channel, combine with |
+#define DCC_CHANNEL_TICKCOUNT  0x01   // increase tickCounter, use on ONE channel only
+#define DCC_CHANNEL_RAILCOM    0x02   // open a RailCom cutout on BRAKE_PIN_MAIN (needs RAILCOM_CUTOUT)
+#define DCC_CHANNEL_TRIGGER    0x04   // switch TRIGGERPIN at end of preamble (needs USE_TRIGGERPIN)
+#define DCC_CHANNEL_RAILCOM_PROG 0x08 // open a RailCom cutout on BRAKE_PIN_PROG (needs RAILCOM_CUTOUT_PROG)
+#define DCC_CHANNEL_ACCESSORIES 0x10  // send the accessory packets in RegisterListBase::accQueue (needs ACCESSORY_QUEUE)
+
+#define DCC_TRIGGERBIT 1              // middle of first preamble bit
+
+/////////////////////////////////////////////////////////////////////////////////////
+// TIMERS
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// Each timer that can generate a DCC signal is described by a small struct with
+// the same static members:
+//
+//   begin():           configure the timer for 50% duty cycle DCC signals on its OCnB pin
+//   reset():           restart the timer at BOTTOM, used to start timers in phase
+//   enableInterrupt(): enable the Output Compare B Match interrupt of the timer
+//   one(), zero():     load the timer with the duration of the next DCC bit
+//   cyclesToBottom():  CPU cycles until the current DCC ONE bit ends (for the RailCom cutout)
+//
+// The programming track timer has two more, used to join it to the main track:
+//
+//   disableInterrupt(): stop interrupting, the main track interrupt loads the timer instead
+//   follow():           copy count, current bit and output level from timer 1 (timers halted)
+//
+// The timer structs are never instantiated, they only exist to hand the register
+// names to DccChannel at compile time.
+
+// TIMER 1 - OC1B
+// Values for 16-bit OCR1A and OCR1B registers calibrated for 1:1 prescale at 16 MHz clock frequency
+// Resulting waveforms are 200 microseconds for a ZERO bit and 116 microseconds for a ONE bit with exactly 50% duty cycle
+
+#define DCC_ZERO_BIT_TOTAL_DURATION_TIMER1 3199
+#define DCC_ZERO_BIT_PULSE_DURATION_TIMER1 1599
+
+#define DCC_ONE_BIT_TOTAL_DURATION_TIMER1 1855
+#define DCC_ONE_BIT_PULSE_DURATION_TIMER1 927
+
+struct DccTimer1 {
+  static void begin() {
+    bitSet(TCCR1A,WGM10);     // set Timer 1 to FAST PWM, with TOP=OCR1A
+    bitSet(TCCR1A,WGM11);
+    bitSet(TCCR1B,WGM12);
+    bitSet(TCCR1B,WGM13);
+
+    bitSet(TCCR1A,COM1B1);    // set Timer 1, OC1B (pin 10/UNO, pin 12/MEGA) to inverting toggle (actual direction is arbitrary)
+    bitSet(TCCR1A,COM1B0);
+
+    bitClear(TCCR1B,CS12);    // set Timer 1 prescale=1
+    bitClear(TCCR1B,CS11);
+    bitSet(TCCR1B,CS10);
+
+    one();
+  }
+  static void reset() {
+    TCNT1=0;
+  }
+  static void enableInterrupt() {
+    bitSet(TIMSK1,OCIE1B);    // enable interrupt vector for Timer 1 Output Compare B Match (OCR1B)
+  }
+  static inline void one() __attribute__((always_inline)) {
+    OCR1A=DCC_ONE_BIT_TOTAL_DURATION_TIMER1;
+    OCR1B=DCC_ONE_BIT_PULSE_DURATION_TIMER1;
+  }
+  static inline void zero() __attribute__((always_inline)) {
+    OCR1A=DCC_ZERO_BIT_TOTAL_DURATION_TIMER1;
+    OCR1B=DCC_ZERO_BIT_PULSE_DURATION_TIMER1;
+  }
+  static inline unsigned int cyclesToBottom() __attribute__((always_inline)) {
+    return DCC_ONE_BIT_TOTAL_DURATION_TIMER1+1-TCNT1;
+  }
+};
+
+#ifdef ARDUINO_AVR_UNO
+
+// TIMER 0 - OC0B (UNO only, on the MEGA timer 0 is left to the Arduino core)
+// Values for 8-bit OCR0A and OCR0B registers calibrated for 1:64 prescale at 16 MHz clock frequency
+// Resulting waveforms are 200 microseconds for a ZERO bit and 116 microseconds for a ONE bit with as-close-as-possible to 50% duty cycle
+
+#define DCC_ZERO_BIT_TOTAL_DURATION_TIMER0 49
+#define DCC_ZERO_BIT_PULSE_DURATION_TIMER0 24
+
+#define DCC_ONE_BIT_TOTAL_DURATION_TIMER0 28
+#define DCC_ONE_BIT_PULSE_DURATION_TIMER0 14
+
+struct DccTimer0 {
+  static void begin() {
+    bitSet(TCCR0A,WGM00);     // set Timer 0 to FAST PWM, with TOP=OCR0A
+    bitSet(TCCR0A,WGM01);
+    bitSet(TCCR0B,WGM02);
+
+    bitSet(TCCR0A,COM0B1);    // set Timer 0, OC0B (pin 5) to inverting toggle (actual direction is arbitrary)
+    bitSet(TCCR0A,COM0B0);
+
+    bitClear(TCCR0B,CS02);    // set Timer 0 prescale=64
+    bitSet(TCCR0B,CS01);
+    bitSet(TCCR0B,CS00);
+
+    one();
+  }
+  static void reset() {
+    TCNT0=0;
+  }
+  static void enableInterrupt() {
+    TIFR0=_BV(OCF0B);         // forget a match that happened while the interrupt was off
+    bitSet(TIMSK0,OCIE0B);    // enable interrupt vector for Timer 0 Output Compare B Match (OCR0B)
+  }
+  static void disableInterrupt() {
+    bitClear(TIMSK0,OCIE0B);
+  }
+  static inline void follow() __attribute__((always_inline)) {
+    bitClear(TCCR0A,WGM00);   // NORMAL mode for a moment, OCR0A/OCR0B are not buffered
+    bitClear(TCCR0A,WGM01);
+    bitClear(TCCR0B,WGM02);
+    if(OCR1A==DCC_ONE_BIT_TOTAL_DURATION_TIMER1){   // current bit of timer 1, its buffer was not reloaded yet
+      OCR0A=DCC_ONE_BIT_TOTAL_DURATION_TIMER0;
+      OCR0B=DCC_ONE_BIT_PULSE_DURATION_TIMER0;
+    } else {
+      OCR0A=DCC_ZERO_BIT_TOTAL_DURATION_TIMER0;
+      OCR0B=DCC_ZERO_BIT_PULSE_DURATION_TIMER0;
+    }
+    TCNT0=TCNT1>>6;           // prescale 64 versus 1: round timer 1 down to a whole timer 0
+    TCNT1&=~63;               // tick, which repeats at most 4 microseconds of the current bit
+    bitSet(TCCR0B,FOC0B);     // timer 1 is past OCR1B, so its output is set: set OC0B too
+    bitSet(TCCR0A,WGM00);     // back to FAST PWM
+    bitSet(TCCR0A,WGM01);
+    bitSet(TCCR0B,WGM02);
+  }
+  static inline void one() __attribute__((always_inline)) {
+    OCR0A=DCC_ONE_BIT_TOTAL_DURATION_TIMER0;
+    OCR0B=DCC_ONE_BIT_PULSE_DURATION_TIMER0;
+  }
+  static inline void zero() __attribute__((always_inline)) {
+    OCR0A=DCC_ZERO_BIT_TOTAL_DURATION_TIMER0;
+    OCR0B=DCC_ZERO_BIT_PULSE_DURATION_TIMER0;
+  }
+  static inline unsigned int cyclesToBottom() __attribute__((always_inline)) {
+    // timer 0 shares its prescaler with timer 1, which was started with the prescaler
+    // and both bit lengths are a multiple of 64 cycles, so the low 6 bits of TCNT1 are
+    // how far the prescaler has come towards the next timer 0 count
+    return (DCC_ONE_BIT_TOTAL_DURATION_TIMER0+1-TCNT0)*64-(TCNT1&63);
+  }
+};
+
+#else
+
+// TIMER 3 - OC3B (MEGA only)
+// Values for 16-bit OCR3A and OCR3B registers calibrated for 1:1 prescale at 16 MHz clock frequency
+// Resulting waveforms are 200 microseconds for a ZERO bit and 116 microseconds for a ONE bit with exactly 50% duty cycle
+
+#define DCC_ZERO_BIT_TOTAL_DURATION_TIMER3 3199
+#define DCC_ZERO_BIT_PULSE_DURATION_TIMER3 1599
+
+#define DCC_ONE_BIT_TOTAL_DURATION_TIMER3 1855
+#define DCC_ONE_BIT_PULSE_DURATION_TIMER3 927
+
+struct DccTimer3 {
+  static void begin() {
+    bitSet(TCCR3A,WGM30);     // set Timer 3 to FAST PWM, with TOP=OCR3A
+    bitSet(TCCR3A,WGM31);
+    bitSet(TCCR3B,WGM32);
+    bitSet(TCCR3B,WGM33);
+
+    bitSet(TCCR3A,COM3B1);    // set Timer 3, OC3B (pin 2) to inverting toggle (actual direction is arbitrary)
+    bitSet(TCCR3A,COM3B0);
+
+    bitClear(TCCR3B,CS32);    // set Timer 3 prescale=1
+    bitClear(TCCR3B,CS31);
+    bitSet(TCCR3B,CS30);
+
+    one();
+  }
+  static void reset() {
+    TCNT3=0;
+  }
+  static void enableInterrupt() {
+    TIFR3=_BV(OCF3B);         // forget a match that happened while the interrupt was off
+    bitSet(TIMSK3,OCIE3B);    // enable interrupt vector for Timer 3 Output Compare B Match (OCR3B)
+  }
+  static void disableInterrupt() {
+    bitClear(TIMSK3,OCIE3B);
+  }
+  static inline void follow() __attribute__((always_inline)) {
+    bitClear(TCCR3A,WGM30);   // NORMAL mode for a moment, OCR3A/OCR3B are not buffered
+    bitClear(TCCR3A,WGM31);
+    bitClear(TCCR3B,WGM32);
+    bitClear(TCCR3B,WGM33);
+    OCR3A=OCR1A;              // current bit of timer 1, its buffer was not reloaded yet
+    OCR3B=OCR1B;
+    TCNT3=TCNT1;
+    TCCR3C=_BV(FOC3B);        // timer 1 is past OCR1B, so its output is set: set OC3B too
+    bitSet(TCCR3A,WGM30);     // back to FAST PWM
+    bitSet(TCCR3A,WGM31);
+    bitSet(TCCR3B,WGM32);
+    bitSet(TCCR3B,WGM33);
+  }
+  static inline void one() __attribute__((always_inline)) {
+    OCR3A=DCC_ONE_BIT_TOTAL_DURATION_TIMER3;
+    OCR3B=DCC_ONE_BIT_PULSE_DURATION_TIMER3;
+  }
+  static inline void zero() __attribute__((always_inline)) {
+    OCR3A=DCC_ZERO_BIT_TOTAL_DURATION_TIMER3;
+    OCR3B=DCC_ZERO_BIT_PULSE_DURATION_TIMER3;
+  }
+  static inline unsigned int cyclesToBottom() __attribute__((always_inline)) {
+    return DCC_ONE_BIT_TOTAL_DURATION_TIMER3+1-TCNT3;
+  }
+};
+
+// TIMER 4 - OC4B (MEGA only, drives main district 2)
+// Same calibration as timer 1. It has no interrupt of its own, DccTimerPair loads it
+// together with timer 1 so both timers run in lockstep.
+
+#define DCC_ZERO_BIT_TOTAL_DURATION_TIMER4 3199
+#define DCC_ZERO_BIT_PULSE_DURATION_TIMER4 1599
+
+#define DCC_ONE_BIT_TOTAL_DURATION_TIMER4 1855
+#define DCC_ONE_BIT_PULSE_DURATION_TIMER4 927
+
+struct DccTimer4 {
+  static void begin() {
+    bitSet(TCCR4A,WGM40);     // set Timer 4 to FAST PWM, with TOP=OCR4A
+    bitSet(TCCR4A,WGM41);
+    bitSet(TCCR4B,WGM42);
+    bitSet(TCCR4B,WGM43);
+
+    bitSet(TCCR4A,COM4B1);    // set Timer 4, OC4B (pin 7) to inverting toggle (actual direction is arbitrary)
+    bitSet(TCCR4A,COM4B0);
+
+    bitClear(TCCR4B,CS42);    // set Timer 4 prescale=1
+    bitClear(TCCR4B,CS41);
+    bitSet(TCCR4B,CS40);
+
+    one();
+  }
+  static void reset() {
+    TCNT4=0;
+  }
+  static void enableInterrupt() {
+  }
+  static inline void one() __attribute__((always_inline)) {
+    OCR4A=DCC_ONE_BIT_TOTAL_DURATION_TIMER4;
+    OCR4B=DCC_ONE_BIT_PULSE_DURATION_TIMER4;
+  }
+  static inline void zero() __attribute__((always_inline)) {
+    OCR4A=DCC_ZERO_BIT_TOTAL_DURATION_TIMER4;
+    OCR4B=DCC_ZERO_BIT_PULSE_DURATION_TIMER4;
+  }
+};
+
+// TIMER 5 - OC5B (MEGA only, drives main district 3)
+// Same calibration as timer 1. It has no interrupt of its own, DccTimerPair loads it
+// together with timer 1 so both timers run in lockstep.
+
+#define DCC_ZERO_BIT_TOTAL_DURATION_TIMER5 3199
+#define DCC_ZERO_BIT_PULSE_DURATION_TIMER5 1599
+
+#define DCC_ONE_BIT_TOTAL_DURATION_TIMER5 1855
+#define DCC_ONE_BIT_PULSE_DURATION_TIMER5 927
+
+struct DccTimer5 {
+  static void begin() {
+    bitSet(TCCR5A,WGM50);     // set Timer 5 to FAST PWM, with TOP=OCR5A
+    bitSet(TCCR5A,WGM51);
+    bitSet(TCCR5B,WGM52);
+    bitSet(TCCR5B,WGM53);
+
+    bitSet(TCCR5A,COM5B1);    // set Timer 5, OC5B (pin 45) to inverting toggle (actual direction is arbitrary)
+    bitSet(TCCR5A,COM5B0);
+
+    bitClear(TCCR5B,CS52);    // set Timer 5 prescale=1
+    bitClear(TCCR5B,CS51);
+    bitSet(TCCR5B,CS50);
+
+    one();
+  }
+  static void reset() {
+    TCNT5=0;
+  }
+  static void enableInterrupt() {
+  }
+  static inline void one() __attribute__((always_inline)) {
+    OCR5A=DCC_ONE_BIT_TOTAL_DURATION_TIMER5;
+    OCR5B=DCC_ONE_BIT_PULSE_DURATION_TIMER5;
+  }
+  static inline void zero() __attribute__((always_inline)) {
+    OCR5A=DCC_ZERO_BIT_TOTAL_DURATION_TIMER5;
+    OCR5B=DCC_ZERO_BIT_PULSE_DURATION_TIMER5;
+  }
+};
+
+#endif
+
+// Two timers that generate the same signal.  Only the first one interrupts, the
+// second gets the same OCRnA/OCRnB values in the same interrupt.  As both have the
+// same prescale and OCRnA/OCRnB are double buffered in FAST PWM mode they stay in
+// lockstep as long as they were started in phase (see DCC_TIMERS_HALT below).
+// Pairs can be nested to drive more than two timers.
+
+template<class T1, class T2>
+struct DccTimerPair {
+  static void begin() {
+    T1::begin();
+    T2::begin();
+  }
+  static void reset() {
+    T1::reset();
+    T2::reset();
+  }
+  static void enableInterrupt() {
+    T1::enableInterrupt();
+  }
+  static inline void one() __attribute__((always_inline)) {
+    T1::one();
+    T2::one();
+  }
+  static inline void zero() __attribute__((always_inline)) {
+    T1::zero();
+    T2::zero();
+  }
+  static inline unsigned int cyclesToBottom() __attribute__((always_inline)) {
+    return T1::cyclesToBottom();
+  }
+};
+
+// The main track timer(s) T1 plus the programming track timer T2, which only follows
+// while progTrackJoined says so (see <J> in SerialCommand).  The first bit loaded
+// after a join request halts all timers and lets T2 copy the bit that timer 1 is
+// sending right now, from there on both get the same values like a DccTimerPair.
+// T2 must not interrupt while joined.
+
+template<class T1, class T2>
+struct DccTimerJoin {
+  static void begin() {
+    T1::begin();
+  }
+  static void reset() {
+    T1::reset();
+  }
+  static void enableInterrupt() {
+    T1::enableInterrupt();
+  }
+  static inline void join() __attribute__((always_inline));
+  static inline void one() __attribute__((always_inline)) {
+    if(progTrackJoined){
+      join();
+      T2::one();
+    }
+    T1::one();
+  }
+  static inline void zero() __attribute__((always_inline)) {
+    if(progTrackJoined){
+      join();
+      T2::zero();
+    }
+    T1::zero();
+  }
+  static inline unsigned int cyclesToBottom() __attribute__((always_inline)) {
+    return T1::cyclesToBottom();
+  }
+};
+
+// Stop and restart all timers that share the synchronous prescaler (all but timer 2)
+// so that timers configured in between start counting in the same cycle.
+
+#define DCC_TIMERS_HALT()   GTCCR = _BV(TSM) | _BV(PSRSYNC)
+#define DCC_TIMERS_START()  GTCCR = 0
+
+template<class T1, class T2>
+inline void DccTimerJoin<T1,T2>::join() {
+  if(progTrackJoined==DCC_JOIN_REQUESTED){   // must run before T1 is reloaded
+    DCC_TIMERS_HALT();
+    T2::follow();
+    DCC_TIMERS_START();
+    progTrackJoined=DCC_JOIN_ACTIVE;
+  }
+}
+
+#ifdef RAILCOM_CUTOUT
+
+/////////////////////////////////////////////////////////////////////////////////////
+// RAILCOM CUTOUT
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// The cutout must start 26-32us and end 454-488us after the end of the packet end bit.
+// The DCC interrupt that loads the first preamble bit runs in the middle of the end bit
+// and asks its timer how far away the end of that bit is (cyclesToBottom()).  From that
+// both edges are scheduled on timer 2, which runs free in NORMAL mode at 2us per count
+// (prescale 32), so they are at most one count off.  Main uses OCR2B, Prog OCR2A.
+//
+// On the MEGA the timer switches the brake pins itself: BRAKE_PIN_MAIN (9) is OC2B and
+// CUTOUT_PIN_PROG (10) is OC2A, jumpered to the brake input of motor channel B.  On the
+// UNO the OC2 pins are the enable pins, so the compare match interrupt switches the brake
+// pins there, which adds the interrupt latency.
+//
+// dccCutoutState tells the compare match interrupt whether it is the start or the end.
+
+#define DCC_CUTOUT_START  29           // us after the end of the end bit
+#define DCC_CUTOUT_TICKS  221          // 442us in timer 2 counts: ends 469-473us after the end bit
+
+#define DCC_CUTOUT_MAIN   0x01         // bits of dccCutoutState
+#define DCC_CUTOUT_PROG   0x02
+
+extern volatile byte dccCutoutState;
+
+struct DccCutoutTimer2 {
+  static void begin() {
+    TCCR2A=0;                          // set Timer 2 to NORMAL mode, outputs disconnected
+    TCCR2B=_BV(CS21)|_BV(CS20);        // set Timer 2 prescale=32
+  }
+  // timer 2 count for an edge DCC_CUTOUT_START us after cycles from now.  As the next
+  // count comes 1-32 cycles from now, the edge is 27-31us after the end bit
+  static inline byte at(unsigned int cycles) __attribute__((always_inline)) {
+    return TCNT2+1+((cycles+DCC_CUTOUT_START*16)>>5);
+  }
+};
+
+struct DccCutoutMain {
+  static void begin() {
+    pinMode(BRAKE_PIN_MAIN, OUTPUT);
+    digitalWrite(BRAKE_PIN_MAIN, LOW);
+  }
+  static inline void schedule(unsigned int cycles) __attribute__((always_inline)) {
+    OCR2B=DccCutoutTimer2::at(cycles);
+    TIFR2=_BV(OCF2B);
+#ifndef ARDUINO_AVR_UNO
+    TCCR2A|=_BV(COM2B1)|_BV(COM2B0);   // set OC2B on compare match
+#endif
+    bitSet(TIMSK2,OCIE2B);
+  }
+  static inline void compareMatch() __attribute__((always_inline)) {
+    if(!(dccCutoutState & DCC_CUTOUT_MAIN)){            // cutout has started
+#ifdef ARDUINO_AVR_UNO
+      digitalWriteFast(BRAKE_PIN_MAIN, HIGH);
+#else
+      bitClear(TCCR2A,COM2B0);                          // clear OC2B on next compare match
+#endif
+      OCR2B+=DCC_CUTOUT_TICKS;
+      dccCutoutState|=DCC_CUTOUT_MAIN;
+#ifdef RAILCOM_RECEIVER
+      RailCom::openWindow();
+#endif
+    } else {                                            // cutout has ended
+#ifdef ARDUINO_AVR_UNO
+      digitalWriteFast(BRAKE_PIN_MAIN, LOW);
+#else
+      bitClear(TCCR2A,COM2B1);                          // OC2B is low, disconnect
+#endif
+      bitClear(TIMSK2,OCIE2B);
+      dccCutoutState&=~DCC_CUTOUT_MAIN;
+#ifdef RAILCOM_RECEIVER
+      RailCom::closeWindow();
+#endif
+    }
+  }
+};
+
+#ifdef RAILCOM_CUTOUT_PROG
+struct DccCutoutProg {
+  static void begin() {
+#ifdef ARDUINO_AVR_UNO
+    pinMode(BRAKE_PIN_PROG, OUTPUT);
+    digitalWrite(BRAKE_PIN_PROG, LOW);
+#else
+    pinMode(BRAKE_PIN_PROG, INPUT);    // ensure this pin is not active! Brake will be controlled by CUTOUT_PIN_PROG instead
+    pinMode(CUTOUT_PIN_PROG, OUTPUT);
+    digitalWrite(CUTOUT_PIN_PROG, LOW);
+#endif
+  }
+  static inline void schedule(unsigned int cycles) __attribute__((always_inline)) {
+    OCR2A=DccCutoutTimer2::at(cycles);
+    TIFR2=_BV(OCF2A);
+#ifndef ARDUINO_AVR_UNO
+    TCCR2A|=_BV(COM2A1)|_BV(COM2A0);   // set OC2A on compare match
+#endif
+    bitSet(TIMSK2,OCIE2A);
+  }
+  static inline void compareMatch() __attribute__((always_inline)) {
+    if(!(dccCutoutState & DCC_CUTOUT_PROG)){            // cutout has started
+#ifdef ARDUINO_AVR_UNO
+      digitalWriteFast(BRAKE_PIN_PROG, HIGH);
+#else
+      bitClear(TCCR2A,COM2A0);                          // clear OC2A on next compare match
+#endif
+      OCR2A+=DCC_CUTOUT_TICKS;
+      dccCutoutState|=DCC_CUTOUT_PROG;
+    } else {                                            // cutout has ended
+#ifdef ARDUINO_AVR_UNO
+      digitalWriteFast(BRAKE_PIN_PROG, LOW);
+#else
+      bitClear(TCCR2A,COM2A1);                          // OC2A is low, disconnect
+#endif
+      bitClear(TIMSK2,OCIE2A);
+      dccCutoutState&=~DCC_CUTOUT_PROG;
+    }
+  }
+};
+#endif
+
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////////
+// THE INTERRUPT CODE
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// DccChannel<Timer,Preamble,Features>::interrupt(R) is called every time an interrupt is
+// triggered on OCnB of the Timer.  It is designed to read the current bit of the current
+// register packet of R and updates the OCnA and OCnB counters of the Timer to values that
+// will either produce a long (200 microsecond) pulse, or a short (116 microsecond) pulse,
+// which respectively represent DCC ZERO and DCC ONE bits.
+//
+// Everything that distinguishes two channels (timer registers, preamble length and the
+// optional tick counter, RailCom cutout and trigger pin code) is a template parameter,
+// so the compiler generates one copy of the code per channel with all constants folded
+// in, exactly as the DCC_SIGNAL macro this replaces did.  interrupt() is forced inline
+// and gets the RegisterList<N> itself, so that the list, which is always a global, and
+// its register array end up at fixed addresses too.
+//
+// Timer:    one of the DccTimerN structs above
+// Preamble: preamble length (14 or 16 for RailCom on Main, 22 on Prog)
+// Features: DCC_CHANNEL_* flags
+
+// optimize time critical stuff harder
+#pragma GCC push_options
+#pragma GCC optimize ("-O3")
+
+template<class Timer, byte Preamble, byte Features>
+struct DccChannel {
+  template<class List> static inline void interrupt(volatile List &R) __attribute__((always_inline));
+  template<class List> static inline byte nextBit(volatile List &R) __attribute__((always_inline));
+  template<class List> static inline byte packetBits(volatile List &R) __attribute__((always_inline));
+  template<class List> static inline void nextRegister(volatile List &R) __attribute__((always_inline));
+#ifdef COMPACT_REGISTERS
+  template<class List> static inline byte dataBit(volatile List &R) __attribute__((always_inline));
+#endif
+#ifdef REGISTER_STATS
+  template<class List> static inline void recordTransmit(volatile List &R) __attribute__((always_inline));
+#endif
+#ifdef ACCESSORY_QUEUE
+  template<class List> static inline byte accessoryPacket(volatile List &R) __attribute__((always_inline));
+#endif
+};
+
+#ifdef REGISTER_STATS
+// Bookkeeping for the <U> command. Runs once per packet, so keep it short.
+template<class Timer, byte Preamble, byte Features>
+template<class List>
+inline void DccChannel<Timer,Preamble,Features>::recordTransmit(volatile List &R) {
+  RegisterStats *s=(RegisterStats *)R.statsTable+(R.currentReg-R.regs);
+  unsigned long now=tickCounter;
+  if(!s->restart){
+    unsigned long gap=(now-s->lastTick)>>REGISTER_STATS_SHIFT;
+    s->sumGap+=gap;
+    s->nGaps++;
+    if(gap>0xFFFF)
+      gap=0xFFFF;
+    if(gap<s->minGap)
+      s->minGap=gap;
+    if(gap>s->maxGap)
+      s->maxGap=gap;
+  }
+  s->lastTick=now;
+  s->restart=0;
+  s->count++;
+  if(R.currentReg==R.regs)
+    R.oneShotPackets++;
+}
+#endif
+
+template<class Timer, byte Preamble, byte Features>
+template<class List>
+inline void DccChannel<Timer,Preamble,Features>::interrupt(volatile List &R) {
+#ifdef TRIGGERPIN
+  if(Features & DCC_CHANNEL_TRIGGER)
+#ifndef USE_TRIGGERPIN_PER_BIT
+    if(R.currentBit == DCC_TRIGGERBIT)
+#endif
+      digitalWriteFast(TRIGGERPIN,HIGH);
+#endif
+#ifdef RAILCOM_RECEIVER
+  if((Features & DCC_CHANNEL_RAILCOM) && R.currentBit == packetBits(R)+Preamble)
+    RailCom::packet=R.currentReg;                     // decoders answer to this packet in the cutout
+#endif
+
+  if(nextBit(R))                                      // IF bit is a ONE
+    Timer::one();                                     //   set OCRA and OCRB of the timer to the durations of a DCC ONE bit
+  else                                                // ELSE it is a ZERO
+    Timer::zero();                                    //   set OCRA and OCRB of the timer to the durations of a DCC ZERO bit
+
+#ifdef RAILCOM_CUTOUT
+  if((Features & DCC_CHANNEL_RAILCOM) && R.currentBit == 1)       // first preamble bit loaded, the end bit is
+    DccCutoutMain::schedule(Timer::cyclesToBottom());             // on the track: schedule the RailCom cutout
+#endif
+#ifdef RAILCOM_CUTOUT_PROG
+  if((Features & DCC_CHANNEL_RAILCOM_PROG) && R.currentBit == 1)
+    DccCutoutProg::schedule(Timer::cyclesToBottom());
+#endif
+
+#ifdef TRIGGERPIN
+  if(Features & DCC_CHANNEL_TRIGGER)
+#ifndef USE_TRIGGERPIN_PER_BIT
+    if(R.currentBit == (DCC_TRIGGERBIT + 1))          // currentBit was incremented by nextBit()
+#endif
+      digitalWriteFast(TRIGGERPIN,LOW);
+#endif
+}
+
+#ifdef ACCESSORY_QUEUE
+// Called at the end of every packet.  After ACCESSORY_RATIO loco packets the first packet
+// in R.accQueue goes in between, if its wait is over, and 1 is returned.  The register
+// sent before it is kept in R.resumeReg, and once the accessory packet is out the
+// register walk goes on from there as if nothing had been in between.
+
+template<class Timer, byte Preamble, byte Features>
+template<class List>
+inline byte DccChannel<Timer,Preamble,Features>::accessoryPacket(volatile List &R) {
+  AccessoryPacket *a=R.accQueue+R.accHead;
+
+  if(R.resumeReg!=NULL){                              // IF an accessory packet is out
+    if(--a->nSend==0){                                //   AND it was the last time: next one
+      R.accHead=(R.accHead+1)%ACCESSORY_QUEUE;
+      R.accCount--;
+      R.accLastTick=tickCounter;
+    }
+    R.currentReg=R.resumeReg;
+    R.resumeReg=NULL;
+    return 0;
+  }
+  if(++R.accPackets<ACCESSORY_RATIO || R.accCount==0 || tickCounter-R.accLastTick<a->wait)
+    return 0;
+  R.accPackets=0;
+  R.resumeReg=R.currentReg;
+  R.currentReg=&a->reg;
+  return 1;
+}
+#endif
+
+// Number of bits after the preamble of the packet being sent
+
+template<class Timer, byte Preamble, byte Features>
+template<class List>
+inline byte DccChannel<Timer,Preamble,Features>::packetBits(volatile List &R) {
+#ifdef COMPACT_REGISTERS
+  return R.nBits;
+#else
+  return R.currentReg->nBits;
+#endif
+}
+
+#ifdef COMPACT_REGISTERS
+// Next bit after the preamble when the registers only hold the packet bytes.  Between two
+// bytes comes a start bit, a ZERO, which is when the next byte (or at last the checksum)
+// is fetched into R.look, so a data bit is only a shift.  After the checksum the end bit.
+
+template<class Timer, byte Preamble, byte Features>
+template<class List>
+inline byte DccChannel<Timer,Preamble,Features>::dataBit(volatile List &R) {
+  byte b;
+
+  if(R.lookBits==0){
+    byte n=R.currentReg->nBytes & ~REGISTER_INVALID;
+    if(R.lookIndex>n)                                 // checksum is out
+      return 1;                                       //   end bit
+    if(R.lookIndex<n){
+      b=R.currentReg->buf[R.lookIndex];
+      R.checksum^=b;
+    } else
+      b=R.checksum;
+    R.look=b;
+    R.lookIndex++;
+    R.lookBits=8;
+    return 0;                                         // start bit
+  }
+  b=R.look;
+  R.look=b<<1;
+  R.lookBits--;
+  return b & 0x80;
+}
+#endif
+
+// Picks the register for the next packet: register 0 again while it is repeated, else the
+// one loadPacket() just filled, else the next one in turn.
+
+template<class Timer, byte Preamble, byte Features>
+template<class List>
+inline void DccChannel<Timer,Preamble,Features>::nextRegister(volatile List &R) {
+  if(R.nRepeat>0 && R.currentReg==R.regs) {          // IF current Register is first Register AND should be repeated
+    R.nRepeat--;                                      //   decrement repeat count; result is this same Packet will be repeated
+  } else if(R.nextReg!=NULL){                         // ELSE IF another Register has been updated
+    R.currentReg=R.nextReg;                           //   update currentReg to nextReg
+    R.nextReg=NULL;                                   //   reset nextReg to NULL
+  } else{                                             // ELSE simply move to next Register
+    if(R.currentReg==R.maxLoadedReg)                  //   BUT IF this is last Register loaded
+      R.currentReg=(Register *)R.regs;                //     first reset currentReg to base Register, THEN
+    R.currentReg++;                                   // increment current Register (note this logic causes Register[0] to be skipped when simply cycling through all Registers)
+  }                                                   // END-ELSE
+}
+
+// Walks R to the next DCC bit to send and returns 1 for a ONE and 0 for a ZERO.  Shared
+// by all signal generators, the timer one above and the USART one below.
+
+template<class Timer, byte Preamble, byte Features>
+template<class List>
+inline byte DccChannel<Timer,Preamble,Features>::nextBit(volatile List &R) {
+  if(R.currentBit==packetBits(R)+Preamble) {         // IF no more bits in this DCC Packet
+    R.packetsTransmitted++;                           // One more packet out 100%
+#ifdef REGISTER_STATS
+#ifdef ACCESSORY_QUEUE
+    if(R.resumeReg==NULL) {                           // accQueue packets have no statistics
+      recordTransmit(R);                              // Refresh statistics for <U>
+    }
+#else
+    recordTransmit(R);                                // Refresh statistics for <U>
+#endif
+#endif
+    R.currentBit=0;                                   //   reset current bit pointer and determine which Register and Packet to process next---
+#ifdef ACCESSORY_QUEUE
+    if(!(Features & DCC_CHANNEL_ACCESSORIES) || !accessoryPacket(R)) {  // unless an accessory packet goes in between
+      nextRegister(R);
+    }
+#else
+    nextRegister(R);
+#endif
+                                                      // HERE currentReg, activePacket, and currentBit should now be properly set to point to next DCC bit
+                                                      // Look at next packet
+#ifdef COMPACT_REGISTERS
+    if(R.currentReg->nBytes & REGISTER_INVALID) {     // IF invalid flag is set skip
+#else
+    if((R.currentReg->buf)[6] & 0x01) {               // IF invalid flag is set skip
+#endif
+      if(R.currentReg==R.maxLoadedReg)                //     BUT IF this is last Register loaded
+        R.currentReg=(Register *)R.regs;              //       first reset currentReg to base Register, THEN
+      R.currentReg++;                                 // jump to next register
+    }
+#ifdef COMPACT_REGISTERS
+    byte n=R.currentReg->nBytes & ~REGISTER_INVALID;
+    R.nBits=n ? n*9+10 : 0;                           // each byte and the checksum with its start bit, end bit
+    R.lookIndex=0;
+    R.lookBits=0;
+    R.checksum=0;
+#endif
+  }                                                   // END-BIG-IF
+
+  byte bit;
+#ifdef COMPACT_REGISTERS
+  if(R.currentBit < Preamble || dataBit(R)) {         // IF bit is a ONE
+#else
+  if(R.currentBit < Preamble || ( (R.currentReg->buf)[(R.currentBit-Preamble)/8] & R.bitMask[(R.currentBit-Preamble)%8] )) {  // IF bit is a ONE
+#endif
+    bit=1;
+    if(Features & DCC_CHANNEL_TICKCOUNT)
+      tickCounter+=DCC_ONE_TICKS;
+  } else {                                            // ELSE it is a ZERO
+    bit=0;
+    if(Features & DCC_CHANNEL_TICKCOUNT)
+      tickCounter+=DCC_ZERO_TICKS;
+  }                                                   // END-ELSE
+
+  R.currentBit++;                                     // point to next bit in current Packet
+  return bit;
+
+}
+
+#ifdef DCC_GENERATOR_USART
+
+/////////////////////////////////////////////////////////////////////////////////////
+// THE USART SIGNAL GENERATOR (MEGA only, see DCC_GENERATOR_USART in Config.h)
+/////////////////////////////////////////////////////////////////////////////////////
+//
+// A USART in Master SPI mode shifts out its data register without any gap as long as
+// the next byte is written while the current one is still going out.  With one SPI bit
+// (a unit) lasting 58 microseconds, a DCC ONE is the two units 10 and a DCC ZERO the
+// four units 1100.  So a byte carries two to four DCC bits, and there is one interrupt
+// (data register empty) per byte instead of one per DCC bit.  A ZERO that does not fit
+// into the byte any more ends with its two 0 units at the start of the next byte.
+//
+// UBRR = 16MHz * 58us / 2 - 1 = 463 (in Master SPI mode the unit is 2*(UBRR+1) cycles)
+
+#define DCC_USART_UBRR  463
+#define DCC_USART_ONE   0x8000        // units 10 left aligned in 16 bits
+#define DCC_USART_ZERO  0xC000        // units 1100 left aligned in 16 bits
+
+// USART 2 - TXD2 (pin 16)
+
+struct DccUsart2 {
+  static void begin() {
+    UBRR2=0;                          // baud rate must be 0 while the transmitter is enabled
+    bitSet(DDRH,DDH2);                // XCK2 must be an output for Master SPI mode (no header pin)
+    UCSR2C=_BV(UMSEL21)|_BV(UMSEL20); // Master SPI mode 0, MSB first
+    UCSR2B=_BV(TXEN2);
+    UBRR2=DCC_USART_UBRR;
+  }
+  static void reset() {
+  }
+  static void enableInterrupt() {
+    bitSet(UCSR2B,UDRIE2);            // enable interrupt vector for USART 2 Data Register Empty
+  }
+  static inline void send(byte b) __attribute__((always_inline)) {
+    UDR2=b;
+  }
+};
+
+// USART 3 - TXD3 (pin 14)
+
+struct DccUsart3 {
+  static void begin() {
+    UBRR3=0;                          // baud rate must be 0 while the transmitter is enabled
+    bitSet(DDRJ,DDJ2);                // XCK3 must be an output for Master SPI mode (no header pin)
+    UCSR3C=_BV(UMSEL31)|_BV(UMSEL30); // Master SPI mode 0, MSB first
+    UCSR3B=_BV(TXEN3);
+    UBRR3=DCC_USART_UBRR;
+  }
+  static void reset() {
+  }
+  static void enableInterrupt() {
+    bitSet(UCSR3B,UDRIE3);            // enable interrupt vector for USART 3 Data Register Empty
+  }
+  static inline void send(byte b) __attribute__((always_inline)) {
+    UDR3=b;
+  }
+};
+
+// Same as DccChannel but for a DccUsartN struct.  Of the Features only the ones handled
+// in nextBit() work here, DCC_CHANNEL_TICKCOUNT and DCC_CHANNEL_ACCESSORIES; the RailCom
+// cutout and the trigger pin need a timer.  test/usart.cpp checks the bits against the
+// timer generator.
+
+template<class Usart, byte Preamble, byte Features>
+struct DccUsartChannel {
+  static byte nPending;               // 0 units of a ZERO that go into the next byte
+  template<class List> static inline void interrupt(volatile List &R) __attribute__((always_inline));
+};
+
+template<class Usart, byte Preamble, byte Features>
+byte DccUsartChannel<Usart,Preamble,Features>::nPending=0;
+
+template<class Usart, byte Preamble, byte Features>
+template<class List>
+inline void DccUsartChannel<Usart,Preamble,Features>::interrupt(volatile List &R) {
+  unsigned int units=0;
+  byte n=nPending;
+
+  while(n<8){                         // fill the next byte with units
+    if(DccChannel<Usart,Preamble,Features>::nextBit(R)){
+      units|=DCC_USART_ONE>>n;
+      n+=2;
+    } else {
+      units|=DCC_USART_ZERO>>n;
+      n+=4;
+    }
+  }
+  Usart::send(highByte(units));
+  nPending=n-8;
+}
+
+#endif
+
+// pop the -O3
+#pragma GCC pop_options
+
+#endif
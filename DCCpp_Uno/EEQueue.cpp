@@ -0,0 +1,93 @@
+/**********************************************************************
+
+EEQueue.cpp
+COPYRIGHT (c) 2020      Harald Barth
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+#include "Config.h"
+#ifdef EESTORE
+#include "DCCpp_Uno.h"
+#include "EEQueue.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// The EEPROM ready interrupt fires as long as it is enabled and no write is in
+// progress, so it takes the next entry as soon as the previous byte is written and
+// disables itself when the queue is empty.  While entries are waiting nothing else
+// may touch the EEPROM: everybody who uses EEPROM.get() or EEPROM.put() has to call
+// EEQueue::flush() first.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// Queues value to be written to address and returns at once, unless the queue is full.
+
+void EEQueue::put(int address, byte value){
+  EEQueueEntry *e;
+  byte i;
+
+  noInterrupts();
+  for(i=0;i<count;i++){                         // waiting already: only the last value is written
+    e=&queue[(head+i)%EEQUEUE_SIZE];
+    if(e->address==address){
+      e->value=value;
+      interrupts();
+      return;
+    }
+  }
+  interrupts();
+
+  while(count==EEQUEUE_SIZE);                   // full: wait for the interrupt to take one
+
+  noInterrupts();
+  e=&queue[(head+count)%EEQUEUE_SIZE];
+  e->address=address;
+  e->value=value;
+  count++;
+  EECR |= _BV(EERIE);
+  interrupts();
+} // EEQueue::put()
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Waits until all queued bytes are written.  Needs interrupts enabled.
+
+void EEQueue::flush(){
+  while(count>0);
+  while(EECR & _BV(EEPE));                      // the last one takes 3.3ms after it left the queue
+} // EEQueue::flush()
+
+///////////////////////////////////////////////////////////////////////////////
+
+void EEQueue::interrupt(){
+  EEQueueEntry *e;
+
+  if(count==0){
+    EECR &= ~_BV(EERIE);
+    return;
+  }
+  e=&queue[head];
+  EEAR=e->address;
+  EECR |= _BV(EERE);                            // no need to wear the cell if it holds the value already
+  if(EEDR!=e->value){
+    EEDR=e->value;
+    EECR |= _BV(EEMPE);                         // EEPE has to follow within 4 cycles
+    EECR |= _BV(EEPE);
+  }
+  head=(head+1)%EEQUEUE_SIZE;
+  count--;
+} // EEQueue::interrupt()
+
+ISR(EE_READY_vect){
+  EEQueue::interrupt();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+EEQueueEntry EEQueue::queue[EEQUEUE_SIZE];
+volatile byte EEQueue::head=0;
+volatile byte EEQueue::count=0;
+
+#endif
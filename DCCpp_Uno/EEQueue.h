@@ -0,0 +1,39 @@
+/**********************************************************************
+
+EEQueue.h
+COPYRIGHT (c) 2020      Harald Barth
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+#ifndef EEQueue_h
+#define EEQueue_h
+
+#include "Arduino.h"
+#include "Config.h"
+
+// Bytes waiting to be written to the EEPROM by the EEPROM ready interrupt, one
+// every 3.3ms.  A new value for an address that is still waiting replaces the
+// old one.
+#if defined ARDUINO_AVR_UNO
+#define EEQUEUE_SIZE         10     // two EEStore journal records, 3 bytes per entry
+#else
+#define EEQUEUE_SIZE         32
+#endif
+
+struct EEQueueEntry{
+  int address;
+  byte value;
+};
+
+struct EEQueue{
+  static EEQueueEntry queue[EEQUEUE_SIZE];
+  static volatile byte head;                       // entry to be written next
+  static volatile byte count;                      // entries waiting
+  static void put(int, byte);
+  static void flush();
+  static void interrupt();
+}; // EEQueue
+
+#endif
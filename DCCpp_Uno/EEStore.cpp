@@ -2,6 +2,7 @@
 
 EEStore.cpp
 COPYRIGHT (c) 2013-2016 Gregg E. Berman
+              2020      Harald Barth
 
 Part of DCC++ BASE STATION for the Arduino
 
@@ -11,59 +12,441 @@ Part of DCC++ BASE STATION for the Arduino
 #ifdef EESTORE
 #include "DCCpp_Uno.h"
 #include "EEStore.h"
+#include "EEQueue.h"
 #include "Accessories.h"
 #include "Sensor.h"
 #include "Outputs.h"
+#include "PacketRegister.h"
 #include <EEPROM.h>
+#include <util/crc16.h>
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// A snapshot is only written by <E>, <e> and when the journal is full, always into
+// the slot not in use, header last.  If that write is torn the CRC of the new slot is
+// wrong and the old slot with its journal is used on the next boot.  A torn journal
+// record has a wrong CRC and ends the replay, so the next record is written over it.
+//
+// Turnout and output states go into the journal, one record per change, so every
+// journal byte is written only once per round through the journal instead of all
+// changes of a turnout hitting the same byte.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#define EESTORE_SLOT_SIZE      (sizeof(EEStoreData)+MAX_TURNOUTS*sizeof(TurnoutData)+MAX_SENSORS*sizeof(SensorData)+MAX_OUTPUTS*sizeof(OutputData))
+#define EESTORE_JOURNAL_START  (2*EESTORE_SLOT_SIZE)
+#ifdef RESTORE_LOCOS
+#define EESTORE_LOCOS_START    (E2END+1-RESTORE_LOCOS*sizeof(EELoco))
+#else
+#define EESTORE_LOCOS_START    (E2END+1)
+#endif
+#define EESTORE_JOURNAL_FIT    ((EESTORE_LOCOS_START-EESTORE_JOURNAL_START)/sizeof(EEJournalRecord))
+
+// Old records ahead of the head are EESTORE_JOURNAL_SIZE sequence numbers behind, they
+// would look current if that was a multiple of 256
+#define EESTORE_JOURNAL_SIZE   ((int)(EESTORE_JOURNAL_FIT%256 ? EESTORE_JOURNAL_FIT : EESTORE_JOURNAL_FIT-1))
+
+static_assert(EESTORE_LOCOS_START>=EESTORE_JOURNAL_START+16*sizeof(EEJournalRecord),
+  "CANNOT COMPILE - TWO COPIES OF THE TURNOUT, SENSOR AND OUTPUT TABLES DO NOT FIT IN THE EEPROM - PLEASE LOWER MAX_TURNOUTS, MAX_SENSORS OR MAX_OUTPUTS");
 
 ///////////////////////////////////////////////////////////////////////////////
 
 void EEStore::init(){
+  EEStoreData d[2];
+  byte ok[2];
 
-  
-  eeStore=(EEStore *)calloc(1,sizeof(EEStore));
+  EEQueue::flush();
+  for(byte s=0;s<2;s++){
+    EEPROM.get(slotAddress(s),d[s]);
+    ok[s]=valid(&d[s],slotAddress(s));
+  }
 
-  EEPROM.get(0,eeStore->data);                                       // get eeStore data 
-  
-  if(strncmp(eeStore->data.id,EESTORE_ID,sizeof(EESTORE_ID))!=0){    // check to see that eeStore contains valid DCC++ ID
-    sprintf(eeStore->data.id,EESTORE_ID);                           // if not, create blank eeStore structure (no turnouts, no sensors) and save it back to EEPROM
+  if(ok[0] || ok[1]){
+    if(ok[0] && ok[1])
+      slot=((signed char)(d[1].seq-d[0].seq)>0);               // the newer one
+    else
+      slot=ok[1];
+    eeStore->data=d[slot];
+  } else {                                                      // no valid slot, create blank eeStore structure (no turnouts, no sensors) and save it back to EEPROM
+    slot=0;
+    eeStore->data.seq=0xFF;
     eeStore->data.nTurnouts=0;
     eeStore->data.nSensors=0;
     eeStore->data.nOutputs=0;
-    EEPROM.put(0,eeStore->data);    
+    jHead=0;
+    jSeq=0;
+    if(convert())
+      return;
+    commit();
   }
-  
-  reset();            // set memory pointer to first free EEPROM space
+
+  reset();            // set memory pointer to the first record of the slot
   Turnout::load();    // load turnout definitions
   Sensor::load();     // load sensor definitions
   Output::load();     // load output definitions
-  
+  replay();           // and the states changed since
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Loads the layout written before EESTORE_VERSION 2, a header without version and CRC at
+// 0 and the records right after it, and stores it again as the first snapshot.  The old
+// records end before the second slot starts, so they are still there when it is written.
+
+byte EEStore::convert(){
+  struct {
+    char id[sizeof(EESTORE_ID)];
+    int nTurnouts;
+    int nSensors;
+    int nOutputs;
+  } old;
+
+  EEPROM.get(0,old);
+  if(strncmp(old.id,EESTORE_ID,sizeof(EESTORE_ID))!=0 || old.nTurnouts<0 || old.nTurnouts>MAX_TURNOUTS ||
+     old.nSensors<0 || old.nSensors>MAX_SENSORS || old.nOutputs<0 || old.nOutputs>MAX_OUTPUTS)
+    return(0);
+
+  eeStore->data.nTurnouts=old.nTurnouts;
+  eeStore->data.nSensors=old.nSensors;
+  eeStore->data.nOutputs=old.nOutputs;
+  eeAddress=sizeof(old);
+  Turnout::load();
+  Sensor::load();
+  Output::load();
+  store();                                                      // into slot 1
+  return(1);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
 void EEStore::clear(){
-    
-  sprintf(eeStore->data.id,EESTORE_ID);                           // create blank eeStore structure (no turnouts, no sensors) and save it back to EEPROM
+
+  EEQueue::flush();
+  bytesWritten=0;
+  slot^=1;                                                        // create blank eeStore structure (no turnouts, no sensors) in the other slot
   eeStore->data.nTurnouts=0;
   eeStore->data.nSensors=0;
   eeStore->data.nOutputs=0;
-  EEPROM.put(0,eeStore->data);    
-  
+  commit();
+
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
 void EEStore::store(){
+  EEQueue::flush();
+  bytesWritten=0;
+  slot^=1;
   reset();
   Turnout::store();
-  Sensor::store();  
-  Output::store();  
-  EEPROM.put(0,eeStore->data);    
+  Sensor::store();
+  Output::store();
+  commit();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Copies the snapshot in use to the other slot with the states of now, so the journal can
+// start over.  Only the records in the EEPROM are copied: turnouts and outputs defined
+// or changed since the last <E> are not stored by this.
+
+void EEStore::compact(){
+  int from=slotAddress(slot)+sizeof(EEStoreData);
+  int to=slotAddress(slot^1)+sizeof(EEStoreData);
+  struct TurnoutData t;
+  struct SensorData s;
+  struct OutputData o;
+  Turnout *tt;
+  Output *oo;
+  int i;
+
+  EEQueue::flush();
+  bytesWritten=0;
+  for(i=0;i<eeStore->data.nTurnouts;i++){
+    EEPROM.get(from,t);
+    tt=Turnout::get(t.id);
+    if(tt!=NULL)
+      t.tStatus=tt->data.tStatus;
+    put(to,t);
+    from+=sizeof(t);
+    to+=sizeof(t);
+  }
+  for(i=0;i<eeStore->data.nSensors;i++){
+    EEPROM.get(from,s);
+    put(to,s);
+    from+=sizeof(s);
+    to+=sizeof(s);
+  }
+  for(i=0;i<eeStore->data.nOutputs;i++){
+    EEPROM.get(from,o);
+    oo=Output::get(o.id);
+    if(oo!=NULL)
+      o.oStatus=oo->data.oStatus;
+    put(to,o);
+    from+=sizeof(o);
+    to+=sizeof(o);
+  }
+  slot^=1;
+  commit();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Writes the header of a new snapshot into slot, after its records have been written
+
+void EEStore::commit(){
+  sprintf(eeStore->data.id,EESTORE_ID);
+  eeStore->data.version=EESTORE_VERSION;
+  eeStore->data.seq++;
+  eeStore->data.jPos=jHead;
+  eeStore->data.jSeq=jSeq;
+  eeStore->data.crc=crc(&eeStore->data,slotAddress(slot));
+  put(slotAddress(slot),eeStore->data);
+  jCount=0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Writes the n bytes at p to the EEPROM at address, but only those that differ from what is
+// there already.  A read takes 4 cycles and a write 3.3ms, and the slot written by store()
+// mostly holds the same records already, two snapshots older.
+
+void EEStore::write(int address, const byte *p, int n){
+  while(n-->0){
+    if(EEPROM.read(address)!=*p){
+      EEPROM.write(address,*p);
+      bytesWritten++;
+    }
+    address++;
+    p++;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Appends a state change to the journal.  It is written in the background by EEQueue.
+
+void EEStore::journal(byte typeValue, int id){
+  EEJournalRecord r;
+  int a;
+
+  if(jCount>=EESTORE_JOURNAL_SIZE)        // the next record would overwrite the first one of the snapshot
+    compact();
+
+  r.seq=jSeq;
+  r.typeValue=typeValue;
+  r.id=id;
+  r.crc=recordCrc(&r);
+  a=journalAddress(jHead);
+  for(byte i=0;i<sizeof(r);i++)
+    EEQueue::put(a+i,((byte *)&r)[i]);
+
+  jHead=(jHead+1)%EESTORE_JOURNAL_SIZE;
+  jSeq++;
+  jCount++;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void EEStore::replay(){
+  EEJournalRecord r;
+  Turnout *tt;
+  Output *oo;
+
+  jHead=eeStore->data.jPos;
+  jSeq=eeStore->data.jSeq;
+  jCount=0;
+
+  while(jCount<EESTORE_JOURNAL_SIZE){
+    EEPROM.get(journalAddress(jHead),r);
+    if(r.seq!=jSeq || r.crc!=recordCrc(&r))       // older than the snapshot, or torn
+      break;
+    switch(r.typeValue & 0xF0){
+      case EESTORE_TURNOUT:
+        tt=Turnout::get(r.id);
+        if(tt!=NULL)
+          tt->data.tStatus=r.typeValue & 0x01;
+        break;
+      case EESTORE_OUTPUT:
+        oo=Output::get(r.id);
+        if(oo!=NULL && !bitRead(oo->data.iFlag,1)){                  // unless bit 1 of iFlag sets the state at power-up
+          oo->data.oStatus=r.typeValue & 0x01;
+          digitalWrite(oo->data.pin,oo->data.oStatus ^ bitRead(oo->data.iFlag,0));
+        }
+        break;
+    }
+    jHead=(jHead+1)%EESTORE_JOURNAL_SIZE;
+    jSeq++;
+    jCount++;
+  }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
+// A slot is valid if it has our id and version, counts that fit and the right CRC
+
+byte EEStore::valid(const EEStoreData *d, int address){
+  if(strncmp(d->id,EESTORE_ID,sizeof(EESTORE_ID))!=0 || d->version!=EESTORE_VERSION)
+    return(0);
+  if(d->nTurnouts<0 || d->nTurnouts>MAX_TURNOUTS || d->nSensors<0 || d->nSensors>MAX_SENSORS ||
+     d->nOutputs<0 || d->nOutputs>MAX_OUTPUTS || d->jPos<0 || d->jPos>=EESTORE_JOURNAL_SIZE)
+    return(0);
+  return(crc(d,address)==d->crc);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// CRC16 of the header d without its crc and of the records that follow it in the EEPROM
+
+unsigned int EEStore::crc(const EEStoreData *d, int address){
+  unsigned int c=0xFFFF;
+  int n;
+
+  for(n=0;n<(int)offsetof(EEStoreData,crc);n++)
+    c=_crc16_update(c,((const byte *)d)[n]);
+  n=d->nTurnouts*sizeof(TurnoutData)+d->nSensors*sizeof(SensorData)+d->nOutputs*sizeof(OutputData);
+  address+=sizeof(EEStoreData);
+  while(n-->0)
+    c=_crc16_update(c,EEPROM.read(address++));
+  return(c);
+}
+
+byte EEStore::recordCrc(const EEJournalRecord *r){
+  byte c=0xFF;                                  // so neither an erased nor a zeroed record is valid
+
+  for(byte i=0;i<offsetof(EEJournalRecord,crc);i++)
+    c=_crc_ibutton_update(c,((const byte *)r)[i]);
+  return(c);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int EEStore::slotAddress(byte s){
+  return(s*EESTORE_SLOT_SIZE);
+}
+
+int EEStore::journalAddress(int n){
+  return(EESTORE_JOURNAL_START+n*sizeof(EEJournalRecord));
+}
+
+#ifdef RESTORE_LOCOS
+
+// Called by RegisterListBase::setThrottle(), speed as in its speedTable
+
+void EEStore::throttle(int reg, int cab, byte speed){
+  EELoco *l, *free=NULL;
+
+  for(l=locos;l<locos+RESTORE_LOCOS;l++){
+    if(l->reg==reg)
+      break;
+    if(l->reg==0 && free==NULL)
+      free=l;
+  }
+  if(l==locos+RESTORE_LOCOS){
+    if(free==NULL)                          // all taken: this register is not remembered
+      return;
+    l=free;
+    l->reg=reg;
+  }
+  if(l->cab!=cab){                          // another loco on this register, its functions are unknown
+    l->cab=cab;
+    memset(l->fn,0,sizeof(l->fn));
+  }
+  l->speed=speed;
+  locoDirty[l-locos]=1;
+}
+
+// Called by RegisterListBase::setFunction() with the packet byte of a <f CAB BYTE1>
+
+void EEStore::function(int cab, byte b){
+  byte n;
+
+  if((b & 0xE0)==0x80)                      // 100D DDDD: FL,F1-F4
+    n=0;
+  else if((b & 0xF0)==0xB0)                 // 1011 DDDD: F5-F8
+    n=1;
+  else                                      // 1010 DDDD: F9-F12
+    n=2;
+  for(byte i=0;i<RESTORE_LOCOS;i++){
+    if(locos[i].reg!=0 && locos[i].cab==cab){
+      locos[i].fn[n]=b;
+      locoDirty[i]=1;
+    }
+  }
+}
+
+// Called from loop(): hands the changed entries to EEQueue, but only every EESTORE_LOCO_TICKS so
+// a throttle turned for minutes does not wear out the EEPROM.  The CRC is written last.  Only
+// as many entries as the queue has room for go at a time, so loop() never waits for the EEPROM;
+// the rest follow on the next passes.
+
+static_assert(sizeof(EELoco)<=EEQUEUE_SIZE, "CANNOT COMPILE - AN EELoco DOES NOT FIT INTO THE EEQueue");
+
+void EEStore::saveLocos(){
+  int a;
+
+  if((unsigned long)(tickCounter-locoTick)<EESTORE_LOCO_TICKS)
+    return;
+  for(byte i=0;i<RESTORE_LOCOS;i++){
+    if(!locoDirty[i])
+      continue;
+    if(EEQueue::count+sizeof(EELoco)>EEQUEUE_SIZE)   // no room, locoTick stays so we are back next time
+      return;
+    locoDirty[i]=0;
+    locos[i].crc=locoCrc(&locos[i]);
+    a=locoAddress(i);
+    for(byte n=0;n<sizeof(EELoco);n++)
+      EEQueue::put(a+n,((byte *)&locos[i])[n]);
+  }
+  locoTick=tickCounter;                              // all out, wait for the next changes
+}
+
+// Called from setup() when the DCC signals run.  Every saved register gets its throttle setting
+// and its functions sent again.  An entry with a wrong CRC (torn while written) is dropped.
+
+void EEStore::restoreLocos(volatile RegisterListBase *regs){
+  char c[24];
+  byte i, n;
+
+  EEQueue::flush();
+  for(i=0;i<RESTORE_LOCOS;i++){
+    EEPROM.get(locoAddress(i),locos[i]);
+    if(locos[i].crc!=locoCrc(&locos[i]) || locos[i].reg>regs->maxNumRegs)
+      memset(&locos[i],0,sizeof(EELoco));
+  }
+  for(i=0;i<RESTORE_LOCOS;i++){
+    if(locos[i].reg==0)
+      continue;
+    sprintf(c,"%d %d %d %d",locos[i].reg,locos[i].cab,locos[i].speed & 0x7F,locos[i].speed>>7);
+    regs->setThrottle(c);
+    for(n=0;n<sizeof(locos[i].fn);n++){
+      if(locos[i].fn[n]==0)
+        continue;
+      sprintf(c,"%d %d",locos[i].cab,locos[i].fn[n]);
+      regs->setFunction(c);
+    }
+  }
+  memset(locoDirty,0,sizeof(locoDirty));    // what was sent is what is saved
+  locoTick=tickCounter;
+}
+
+int EEStore::locoAddress(int n){
+  return(EESTORE_LOCOS_START+n*sizeof(EELoco));
+}
+
+byte EEStore::locoCrc(const EELoco *l){
+  byte c=0xFF;
+
+  for(byte i=0;i<offsetof(EELoco,crc);i++)
+    c=_crc_ibutton_update(c,((const byte *)l)[i]);
+  return(c);
+}
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
 void EEStore::advance(int n){
   eeAddress+=n;
 }
@@ -71,7 +454,7 @@ void EEStore::advance(int n){
 ///////////////////////////////////////////////////////////////////////////////
 
 void EEStore::reset(){
-  eeAddress=sizeof(EEStore);
+  eeAddress=slotAddress(slot)+sizeof(EEStoreData);
 }
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -80,7 +463,18 @@ int EEStore::pointer(){
 }
 ///////////////////////////////////////////////////////////////////////////////
 
-EEStore *EEStore::eeStore=NULL;
+EEStore EEStore::eeStoreData;
+EEStore *EEStore::eeStore=&EEStore::eeStoreData;
 int EEStore::eeAddress=0;
+byte EEStore::slot=0;
+int EEStore::jHead=0;
+byte EEStore::jSeq=0;
+int EEStore::jCount=0;
+unsigned int EEStore::bytesWritten=0;
+#ifdef RESTORE_LOCOS
+EELoco EEStore::locos[RESTORE_LOCOS];
+byte EEStore::locoDirty[RESTORE_LOCOS];
+unsigned long EEStore::locoTick=0;
+#endif
 
 #endif
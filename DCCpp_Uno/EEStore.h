@@ -2,6 +2,7 @@
 
 EEStore.h
 COPYRIGHT (c) 2013-2016 Gregg E. Berman
+              2020      Harald Barth
 
 Part of DCC++ BASE STATION for the Arduino
 
@@ -9,26 +10,92 @@ Part of DCC++ BASE STATION for the Arduino
 #ifndef EEStore_h
 #define EEStore_h
 
+#include "Arduino.h"
+
 #define  EESTORE_ID "DCC++"
+#define  EESTORE_VERSION      2         // two snapshot slots and a journal
+
+#define  EESTORE_TURNOUT   0x10         // journal record types, or'ed with the new state
+#define  EESTORE_OUTPUT    0x20
+
+// The EEPROM holds two snapshot slots, each a header followed by the turnout, sensor and
+// output records, and after them a journal of state changes.  The valid slot with the
+// newer seq is used, and the journal records from its jPos on with consecutive sequence
+// numbers and a good CRC are replayed on top of it.
 
 struct EEStoreData{
   char id[sizeof(EESTORE_ID)];
+  byte version;
+  byte seq;                             // snapshot number, wraps
   int nTurnouts;
-  int nSensors;  
+  int nSensors;
   int nOutputs;
+  int jPos;                             // first journal record that applies to this snapshot
+  byte jSeq;                            // its sequence number
+  unsigned int crc;                     // CRC16 of the header up to here and of the records
+};
+
+struct EEJournalRecord{
+  byte seq;
+  byte typeValue;
+  int id;
+  byte crc;                             // CRC8 of the bytes above
+};
+
+#ifdef RESTORE_LOCOS
+#define  EESTORE_LOCO_TICKS  7500000UL  // 30s in tickCounter units, at most so often locos are saved
+
+struct EELoco{                          // last <t> for register reg and last <f> for its cab
+  byte reg;                             // 0 = unused
+  int cab;
+  byte speed;                           // as in RegisterListBase::speedTable
+  byte fn[3];                           // FL,F1-F4, F5-F8 and F9-F12 packet bytes, 0 = never set
+  byte crc;                             // CRC8 of the bytes above
 };
 
+struct RegisterListBase;
+#endif
+
 struct EEStore{
+  static EEStore eeStoreData;
   static EEStore *eeStore;
   EEStoreData data;
   static int eeAddress;
+  static byte slot;                     // of the snapshot in data
+  static int jHead;                     // journal record to be written next
+  static byte jSeq;                     // and its sequence number
+  static int jCount;                    // records written since the snapshot
+  static unsigned int bytesWritten;     // by the last store(), clear() or compact()
   static void init();
   static void reset();
   static int pointer();
   static void advance(int);
   static void store();
   static void clear();
+  static void journal(byte, int);
+  static void write(int, const byte *, int);
+  template<class T> static void put(int address, const T &t) { write(address,(const byte *)&t,sizeof(T)); }
+  static int slotAddress(byte);
+  static int journalAddress(int);
+  static unsigned int crc(const EEStoreData *, int);
+  static byte recordCrc(const EEJournalRecord *);
+  static byte valid(const EEStoreData *, int);
+  static void commit();
+  static void compact();
+  static void replay();
+  static byte convert();
+#ifdef RESTORE_LOCOS
+  static EELoco locos[RESTORE_LOCOS];
+  static byte locoDirty[RESTORE_LOCOS];
+  static unsigned long locoTick;
+  static void throttle(int, int, byte);
+  static void function(int, byte);
+  static void saveLocos();
+  static void restoreLocos(volatile RegisterListBase *);
+  static int locoAddress(int);
+  static byte locoCrc(const EELoco *);
+#endif
 };
-  
+
 #endif
 
@@ -0,0 +1,112 @@
+/**********************************************************************
+
+History.cpp
+COPYRIGHT (c) 2020      Harald Barth
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+#include "DCCpp_Uno.h"
+#include "History.h"
+#include "Comm.h"
+
+#ifdef HISTORY
+
+HistoryEntry History::ring[HISTORY_SIZE];
+byte History::next=0;
+byte History::used=0;
+HistoryValue History::run[HISTORY_SERIES];
+unsigned long History::sum[HISTORY_SERIES];
+byte History::count=0;
+byte History::subscribe=0;
+byte History::pushCount=0;
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Called after every current and voltage check with main and prog current in mA
+// and the main track voltage in mV
+void History::sample(unsigned int mainmA, unsigned int progmA, unsigned int mV){
+  unsigned int v[HISTORY_SERIES];
+  HistoryEntry *e;
+
+  v[HISTORY_MAIN]=mainmA;
+  v[HISTORY_PROG]=progmA;
+  v[HISTORY_VOLTAGE]=mV;
+  for(byte i=0;i<HISTORY_SERIES;i++){
+    if(count==0 || v[i]<run[i].min)
+      run[i].min=v[i];
+    if(count==0 || v[i]>run[i].max)
+      run[i].max=v[i];
+    sum[i]=(count==0 ? 0 : sum[i])+v[i];
+  }
+  if(++count<HISTORY_INTERVAL)
+    return;
+
+  e=&ring[next];                                 // interval complete, store it
+  for(byte i=0;i<HISTORY_SERIES;i++){
+    e->v[i].min=run[i].min;
+    e->v[i].mean=sum[i]/HISTORY_INTERVAL;
+    e->v[i].max=run[i].max;
+  }
+  next=(next+1)%HISTORY_SIZE;
+  if(used<HISTORY_SIZE)
+    used++;
+  count=0;
+
+  if(subscribe && ++pushCount>=subscribe){
+    pushCount=0;
+    print(e);
+  }
+} // History::sample
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Prints <h MAINMIN MAINMEAN MAINMAX PROGMIN PROGMEAN PROGMAX VMIN VMEAN VMAX>
+void History::print(const HistoryEntry *e){
+  INTERFACE.print(F("<h"));
+  for(byte i=0;i<HISTORY_SERIES;i++){
+    INTERFACE.print(F(" "));
+    INTERFACE.print(e->v[i].min);
+    INTERFACE.print(F(" "));
+    INTERFACE.print(e->v[i].mean);
+    INTERFACE.print(F(" "));
+    INTERFACE.print(e->v[i].max);
+  }
+  INTERFACE.print(F(">"));
+} // History::print
+
+// Prints all entries, oldest first, followed by <h USED SIZE INTERVAL_MS>
+void History::show(){
+  byte i=(next+HISTORY_SIZE-used)%HISTORY_SIZE;
+
+  for(byte n=0;n<used;n++){
+    print(&ring[i]);
+    i=(i+1)%HISTORY_SIZE;
+  }
+  INTERFACE.print(F("<h "));
+  INTERFACE.print(used);
+  INTERFACE.print(F(" "));
+  INTERFACE.print(HISTORY_SIZE);
+  INTERFACE.print(F(" "));
+  INTERFACE.print((unsigned long)HISTORY_INTERVAL*SAMPLE_TICKS/250);   // 250 ticks per ms
+  INTERFACE.print(F(">"));
+} // History::show
+
+///////////////////////////////////////////////////////////////////////////////
+
+void History::parse(char *s){
+  int n;
+
+  if(sscanf(s,"%d",&n)!=1){
+    show();
+    return;
+  }
+  if(n<0 || n>255)
+    return;
+  subscribe=n;
+  pushCount=0;
+  INTERFACE.print(F("<O>"));
+} // History::parse
+
+#endif
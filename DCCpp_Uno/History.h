@@ -0,0 +1,56 @@
+/**********************************************************************
+
+History.h
+COPYRIGHT (c) 2020      Harald Barth
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+#ifndef History_h
+#define History_h
+
+#include "Arduino.h"
+#include "Config.h"
+
+// One history entry covers HISTORY_INTERVAL current and voltage checks of
+// SAMPLE_TICKS (20ms) each, so with 50 one entry per second.
+#define HISTORY_INTERVAL     50
+
+#if defined ARDUINO_AVR_UNO
+#define HISTORY_SIZE          8     // 18 bytes per entry, the Uno has little RAM to spare
+#else
+#define HISTORY_SIZE         64
+#endif
+
+#define HISTORY_MAIN          0
+#define HISTORY_PROG          1
+#define HISTORY_VOLTAGE       2
+#define HISTORY_SERIES        3
+
+struct HistoryValue{                // in mA or mV
+  unsigned int min;
+  unsigned int mean;
+  unsigned int max;
+};
+
+struct HistoryEntry{
+  HistoryValue v[HISTORY_SERIES];
+};
+
+struct History{
+  static HistoryEntry ring[HISTORY_SIZE];
+  static byte next;                                // entry to be written next
+  static byte used;                                // entries in ring
+  static HistoryValue run[HISTORY_SERIES];         // interval being collected, mean field unused
+  static unsigned long sum[HISTORY_SERIES];
+  static byte count;                               // checks in the interval being collected
+  static byte subscribe;                           // push every subscribe entries, 0 = off
+  static byte pushCount;
+  static void sample(unsigned int, unsigned int, unsigned int);
+  static void print(const HistoryEntry *);
+  static void show();
+  static void parse(char *);
+}; // History
+
+#endif
@@ -24,7 +24,7 @@ output definitions using the following variation of the "Z" command:
                                if output ID already exists, it is updated with specificed PIN and IFLAG.
                                note: output state will be immediately set to ACTIVE/INACTIVE and pin will be set to HIGH/LOW
                                according to IFLAG value specifcied (see below).
-                               returns: <O> if successful and <X> if unsuccessful (e.g. out of memory)
+                               returns: <O> if successful and <X> if unsuccessful (e.g. table full, see MAX_OUTPUTS in DCCpp_Uno.h)
 
   <Z ID>:                      deletes definition of output ID
                                returns: <O> if successful and <X> if unsuccessful (e.g. ID does not exist)
@@ -79,6 +79,7 @@ the state of any outputs being monitored or controlled by a separate interface o
 #include <EEPROM.h>
 #endif
 #include "Comm.h"
+#include "SortedTable.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -87,7 +88,7 @@ void Output::activate(int s){
   digitalWrite(data.pin,data.oStatus ^ bitRead(data.iFlag,0));      // set state of output pin to HIGH or LOW depending on whether bit zero of iFlag is set to 0 (ACTIVE=HIGH) or 1 (ACTIVE=LOW)
 #ifdef EESTORE
   if(num>0)
-    EEPROM.put(num,data.oStatus);
+    EEStore::journal(EESTORE_OUTPUT|data.oStatus,data.id);
 #endif
   INTERFACE.print("<Y");
   INTERFACE.print(data.id);
@@ -100,28 +101,19 @@ void Output::activate(int s){
 ///////////////////////////////////////////////////////////////////////////////
 
 Output* Output::get(int n){
-  Output *tt;
-  for(tt=firstOutput;tt!=NULL && tt->data.id!=n;tt=tt->nextOutput);
-  return(tt); 
+  return(SortedTable<Output>::get(outputs,nOutputs,n));
 }
 ///////////////////////////////////////////////////////////////////////////////
 
 void Output::remove(int n){
-  Output *tt,*pp;
-  
-  for(pp=tt=firstOutput;tt!=NULL && tt->data.id!=n;pp=tt,tt=tt->nextOutput);
+  Output *tt=get(n);
 
   if(tt==NULL){
     INTERFACE.print("<X>");
     return;
   }
   
-  if(tt==firstOutput)
-    firstOutput=tt->nextOutput;
-  else
-    pp->nextOutput=tt->nextOutput;
-
-  free(tt);
+  SortedTable<Output>::remove(outputs,nOutputs,tt-outputs);
 
   INTERFACE.print("<O>");
 }
@@ -131,12 +123,12 @@ void Output::remove(int n){
 void Output::show(int n){
   Output *tt;
 
-  if(firstOutput==NULL){
+  if(nOutputs==0){
     INTERFACE.print("<X>");
     return;
   }
     
-  for(tt=firstOutput;tt!=NULL;tt=tt->nextOutput){
+  for(tt=outputs;tt<outputs+nOutputs;tt++){
     INTERFACE.print("<Y");
     INTERFACE.print(tt->data.id);
     if(n==1){
@@ -191,10 +183,12 @@ void Output::load(){
   for(int i=0;i<EEStore::eeStore->data.nOutputs;i++){
     EEPROM.get(EEStore::pointer(),data);  
     tt=create(data.id,data.pin,data.iFlag);
-    tt->data.oStatus=bitRead(tt->data.iFlag,1)?bitRead(tt->data.iFlag,2):data.oStatus;      // restore status to EEPROM value is bit 1 of iFlag=0, otherwise set to value of bit 2 of iFlag
-    digitalWrite(tt->data.pin,tt->data.oStatus ^ bitRead(tt->data.iFlag,0));
-    pinMode(tt->data.pin,OUTPUT);
-    tt->num=EEStore::pointer();
+    if(tt!=NULL){                                       // NULL if the table is full
+      tt->data.oStatus=bitRead(tt->data.iFlag,1)?bitRead(tt->data.iFlag,2):data.oStatus;      // restore status to EEPROM value is bit 1 of iFlag=0, otherwise set to value of bit 2 of iFlag
+      digitalWrite(tt->data.pin,tt->data.oStatus ^ bitRead(tt->data.iFlag,0));
+      pinMode(tt->data.pin,OUTPUT);
+      tt->num=EEStore::pointer();
+    }
     EEStore::advance(sizeof(tt->data));
   }  
 #endif
@@ -206,14 +200,12 @@ void Output::store(){
   Output *tt;
 
 #ifdef EESTORE  
-  tt=firstOutput;
   EEStore::eeStore->data.nOutputs=0;
   
-  while(tt!=NULL){
+  for(tt=outputs;tt<outputs+nOutputs;tt++){
     tt->num=EEStore::pointer();
-    EEPROM.put(EEStore::pointer(),tt->data);
+    EEStore::put(EEStore::pointer(),tt->data);
     EEStore::advance(sizeof(tt->data));
-    tt=tt->nextOutput;
     EEStore::eeStore->data.nOutputs++;
   }
 #endif
@@ -223,22 +215,20 @@ void Output::store(){
 
 Output *Output::create(int id, int pin, int iFlag, int v){
   Output *tt;
+  int i=SortedTable<Output>::find(outputs,nOutputs,id);
   
-  if(firstOutput==NULL){
-    firstOutput=(Output *)calloc(1,sizeof(Output));
-    tt=firstOutput;
-  } else if((tt=get(id))==NULL){
-    tt=firstOutput;
-    while(tt->nextOutput!=NULL)
-      tt=tt->nextOutput;
-    tt->nextOutput=(Output *)calloc(1,sizeof(Output));
-    tt=tt->nextOutput;
-  }
-
-  if(tt==NULL){       // problem allocating memory
-    if(v==1)
-      INTERFACE.print("<X>");
-    return(tt);
+  if(i<nOutputs && outputs[i].data.id==id){
+    tt=&outputs[i];                   // update existing entry
+  } else {
+    if(nOutputs==MAX_OUTPUTS){            // table full
+      failures++;
+      if(v==1)
+        INTERFACE.print("<X>");
+      return(NULL);
+    }
+    tt=SortedTable<Output>::insert(outputs,nOutputs,i);
+    if(nOutputs>highWater)
+      highWater=nOutputs;
   }
   
   tt->data.id=id;
@@ -259,5 +249,8 @@ Output *Output::create(int id, int pin, int iFlag, int v){
 
 ///////////////////////////////////////////////////////////////////////////////
 
-Output *Output::firstOutput=NULL;
+Output Output::outputs[MAX_OUTPUTS];
+int Output::nOutputs=0;
+int Output::highWater=0;
+int Output::failures=0;
 
@@ -20,12 +20,17 @@ struct OutputData {
 };
 
 struct Output{
-  static Output *firstOutput;
+  static Output outputs[];           // sorted by id, MAX_OUTPUTS entries
+  static int nOutputs;
+  static int highWater;              // most entries ever in use
+  static int failures;               // creates refused because the table was full
   int num;
   struct OutputData data;
-  Output *nextOutput;
   void activate(int s);
   static void parse(char *c);
+  inline int key() {                 // for SortedTable
+      return data.id;
+  }
   static Output* get(int);
   static void remove(int);
   static void load();
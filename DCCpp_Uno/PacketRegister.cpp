@@ -10,16 +10,23 @@ Part of DCC++ BASE STATION for the Arduino
 
 #include "DCCpp_Uno.h"
 #include "PacketRegister.h"
+#include "RailCom.h"
 #include "Comm.h"
+#ifdef RESTORE_LOCOS
+#include "EEStore.h"
+#endif
 
 ///////////////////////////////////////////////////////////////////////////////
     
-RegisterList::RegisterList(int maxNumRegs){
+// The storage comes from RegisterList<N> and is static and zeroed, so nothing is allocated here.
+// REGISTER_STATS tables are set and cleared by RegisterList<N> after this has run.
+
+RegisterListBase::RegisterListBase(int maxNumRegs, Register *reg, Register **regMap, byte *speedTable){
   this->maxNumRegs=maxNumRegs;
   packetsTransmitted = 0;
-  reg=(Register *)calloc((maxNumRegs+1),sizeof(Register));
-  regMap=(Register **)calloc((maxNumRegs+1),sizeof(Register *));
-  speedTable=(byte *)calloc((maxNumRegs+1),sizeof(byte));
+  this->reg=reg;
+  this->regMap=regMap;
+  this->speedTable=speedTable;
   currentReg=reg;
   regMap[0]=reg;
   maxLoadedReg=reg;
@@ -28,7 +35,11 @@ RegisterList::RegisterList(int maxNumRegs){
   currentBit=0;
   nRepeat=0;
   debugcount=0;
-} // RegisterList::RegisterList
+#ifdef ACCESSORY_QUEUE
+  resumeReg=NULL;
+  accPackets=0;
+#endif
+} // RegisterListBase::RegisterListBase
   
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -36,7 +47,7 @@ RegisterList::RegisterList(int maxNumRegs){
 // CONVERTS 2, 3, 4, OR 5 BYTES INTO A DCC BIT STREAM WITH PREAMBLE, CHECKSUM, AND PROPER BYTE SEPARATORS
 // BITSTREAM IS STORED IN UP TO A 9-BYTE ARRAY (USING AT MOST 69 OF 72 BITS)
 
-void RegisterList::loadPacket(int nReg, byte *b, int nBytes, int nRepeat, int printFlag) volatile {
+void RegisterListBase::loadPacket(int nReg, byte *b, int nBytes, int nRepeat, int printFlag) volatile {
   Register *loopReg = NULL;
   Register *newReg = NULL;
   
@@ -60,8 +71,53 @@ void RegisterList::loadPacket(int nReg, byte *b, int nBytes, int nRepeat, int pr
                                       // nextReg will be reset to NULL by interrupt when prior Register updated fully processed
  
   Register *p=regMap[nReg];           // set Register to be updated
+  nBytes=encodePacket(p,b,nBytes);
+
+#ifdef COMPACT_REGISTERS
+  if (nReg != 0 && recycleReg!=NULL)
+      recycleReg->nBytes |= REGISTER_INVALID;
+#else
+  if (nReg != 0 && recycleReg!=NULL)
+      (recycleReg->buf)[6] |= 0x01;   // set invalid flag on recycleReg packet content
+#endif
+
+  if (nReg != 0)                    // if nReg was 0 then we waited above
+    while(nextReg!=NULL);           // busy wait while there is a Register already waiting to be updated
+                                    // nextReg will be reset to NULL by interrupt when prior Register updated fully processed
+  noInterrupts();
+#ifdef REGISTER_STATS
+  if (nReg != 0) {                  // let the statistics follow nReg into its new slot
+    RegisterStats *s=stats+(p-reg);
+    if (recycleReg != NULL)
+      *s=stats[recycleReg-reg];
+    else {
+      s->count=0;
+      s->sumGap=0;
+      s->nGaps=0;
+      s->minGap=0xFFFF;
+      s->maxGap=0;
+    }
+    s->restart=1;                   // do not count the jump to the updated packet as refresh interval
+  }
+#endif
+  nextReg=p;
+  interrupts();
+
+  this->nRepeat=nRepeat;
+  maxLoadedReg=max(maxLoadedReg,nextReg);
+
+  if(printFlag && SHOW_PACKETS)       // for debugging purposes
+    printPacket(nReg,b,nBytes,nRepeat);  
+
+} // RegisterListBase::loadPacket
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Puts the checksum into b[nBytes] and the packet into p, valid.  Returns nBytes with the checksum.
+
+int RegisterListBase::encodePacket(Register *p, byte *b, int nBytes){
   byte *buf=p->buf;                   // set byte buffer in the Packet to be updated
-          
+
   /* Generate checksum and put into the last byte */
 
   b[nBytes]=b[0];                        // copy first byte into what will become the checksum byte  
@@ -69,6 +125,11 @@ void RegisterList::loadPacket(int nReg, byte *b, int nBytes, int nRepeat, int pr
     b[nBytes]^=b[i];
   nBytes++;                              // increment number of bytes in packet to include checksum byte
 
+#ifdef COMPACT_REGISTERS
+  for(int i=0;i<nBytes-1;i++)            // the interrupt routine makes its own checksum
+    buf[i]=b[i];
+  p->nBytes=nBytes-1;                    // this clears the invalid flag as well
+#else
   /* Copy the DCC bits from bytes into the DCC output stream format which has           */
   /* startbits=0 between all bytes and an additional stopbit=1 at the end of the packet */
 
@@ -96,34 +157,21 @@ void RegisterList::loadPacket(int nReg, byte *b, int nBytes, int nRepeat, int pr
       } else{
         buf[5]+=b[5]>>6;                   // b[4] bits 0-4  startbit  b[5] bits 7-6
         buf[6]=b[5]<<2;                    // b[5] bits 0-5  endbit
-        bitSet(buf[5],1);                  // (endbit)
+        bitSet(buf[6],1);                  // (endbit)
         p->nBits=55;
       } // >5 bytes
     } // >4 bytes
   } // >3 bytes
   buf[6] &= 0xFE;                     // clear invalid flag on this register/packet content
-  
-  if (nReg != 0 && recycleReg!=NULL)
-      (recycleReg->buf)[6] |= 0x01;   // set invalid flag on recycleReg packet content
-
-  if (nReg != 0)                    // if nReg was 0 then we waited above
-    while(nextReg!=NULL);           // busy wait while there is a Register already waiting to be updated
-                                    // nextReg will be reset to NULL by interrupt when prior Register updated fully processed
-  noInterrupts();
-  nextReg=p;
-  interrupts();
-
-  this->nRepeat=nRepeat;
-  maxLoadedReg=max(maxLoadedReg,nextReg);
+#endif
 
-  if(printFlag && SHOW_PACKETS)       // for debugging purposes
-    printPacket(nReg,b,nBytes,nRepeat);  
+  return nBytes;
 
-} // RegisterList::loadPacket
+} // RegisterListBase::encodePacket
 
 ///////////////////////////////////////////////////////////////////////////////
 
-void RegisterList::setThrottle(char *s) volatile{
+void RegisterListBase::setThrottle(char *s) volatile{
   byte b[5];                      // save space for checksum byte
   int nReg;
   int cab;
@@ -163,12 +211,15 @@ void RegisterList::setThrottle(char *s) volatile{
   INTERFACE.print(F(">"));
   
   speedTable[nReg]=tSpeed+tDirection*128;
+#ifdef RESTORE_LOCOS
+  EEStore::throttle(nReg,cab,speedTable[nReg]);
+#endif
     
-} // RegisterList::setThrottle()
+} // RegisterListBase::setThrottle()
 
 ///////////////////////////////////////////////////////////////////////////////
 
-void RegisterList::setFunction(char *s) volatile{
+void RegisterListBase::setFunction(char *s) volatile{
   byte b[5];                      // save space for checksum byte
   int cab;
   int fByte, eByte;
@@ -187,6 +238,9 @@ void RegisterList::setFunction(char *s) volatile{
 
   if(nParams==2){                      // this is a request for functions FL,F1-F12  
     b[nB++]=(fByte | 0x80) & 0xBF;     // for safety this guarantees that first nibble of function byte will always be of binary form 10XX which should always be the case for FL,F1-F12  
+#ifdef RESTORE_LOCOS
+    EEStore::function(cab,b[nB-1]);
+#endif
   } else {                             // this is a request for functions F13-F28
     b[nB++]=(fByte | 0xDE) & 0xDF;     // for safety this guarantees that first byte will either be 0xDE (for F13-F20) or 0xDF (for F21-F28)
     b[nB++]=eByte;
@@ -194,12 +248,11 @@ void RegisterList::setFunction(char *s) volatile{
     
   loadPacket(0,b,nB,4,1);
     
-} // RegisterList::setFunction()
+} // RegisterListBase::setFunction()
 
 ///////////////////////////////////////////////////////////////////////////////
 
-void RegisterList::setAccessory(char *s) volatile{
-  byte b[3];                      // save space for checksum byte
+void RegisterListBase::setAccessory(char *s) volatile{
   int aAdd;                       // the accessory address (0-511 = 9 bits) 
   int aNum;                       // the accessory number within that address (0-3)
   int activate;                   // flag indicated whether accessory should be activated (1) or deactivated (0) following NMRA recommended convention
@@ -208,13 +261,35 @@ void RegisterList::setAccessory(char *s) volatile{
     return;
 
   // use masks to detect wrong values and do nothing
-  if(aAdd != aAdd&511)
+  if(aAdd != (aAdd&511))
     return;
-  if(aNum != aNum&3)
+  if(aNum != (aNum&3))
     return;
-  if(activate != activate&1)
+  if(activate != (activate&1))
     return;
 
+#ifdef ACCESSORY_STATE
+  int i=aAdd*4+aNum;
+  if(activate)
+    accessoryState[i/8] |= 1<<(i%8);
+  else
+    accessoryState[i/8] &= ~(1<<(i%8));
+#ifdef ACCESSORY_REFRESH
+  accessoryKnown[i/8] |= 1<<(i%8);
+#endif
+#endif
+
+  loadAccessory(aAdd,aNum,activate,4,1);
+      
+} // RegisterListBase::setAccessory()
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Loads the accessory packet for the checked values aAdd, aNum and activate into register 0.
+
+void RegisterListBase::loadAccessory(int aAdd, int aNum, int activate, int nRepeat, int printFlag) volatile{
+  byte b[3];                      // save space for checksum byte
+
 #ifdef ACCESSORIES_REVERSED
   activate = !activate;
 #endif
@@ -222,78 +297,193 @@ void RegisterList::setAccessory(char *s) volatile{
   b[0]=aAdd%64+128;                                           // first byte is of the form 10AAAAAA, where AAAAAA represent 6 least signifcant bits of accessory address  
   b[1]=((((aAdd/64)%8)<<4) + (aNum<<1) + activate) ^ 0xF8;      // second byte is of the form 1AAACDDD, where C should be 1, and the least significant D represent activate/deactivate
       
-  loadPacket(0,b,2,4,1);
-      
-} // RegisterList::setAccessory()
+#ifdef ACCESSORY_QUEUE
+  queueAccessory(b,nRepeat+1,0);
+  if(printFlag && SHOW_PACKETS)
+    printPacket(0,b,3,nRepeat);
+#ifdef ACCESSORY_PULSE
+  b[1]&=~0x08;                                                // C=0: the same output off again after the pulse
+  queueAccessory(b,nRepeat+1,ACCESSORY_PULSE*250U);
+#endif
+#else
+  loadPacket(0,b,2,nRepeat,printFlag);
+#endif
+
+} // RegisterListBase::loadAccessory()
+
+#ifdef ACCESSORY_QUEUE
+///////////////////////////////////////////////////////////////////////////////
+
+// Appends the 2 byte accessory packet b to accQueue, to be sent nSend times once wait
+// ticks have passed after the packet before it is out.  Waits only if accQueue is full.
+
+void RegisterListBase::queueAccessory(byte *b, int nSend, unsigned int wait){
+  AccessoryPacket *a;
+
+  while(accCount==ACCESSORY_QUEUE);             // full: wait for the interrupt routine to send one
+
+  a=accQueue+(accHead+accCount)%ACCESSORY_QUEUE;  // the interrupt routine does not look at it before accCount++
+  encodePacket(&a->reg,b,2);
+  a->nSend=nSend;
+  a->wait=wait;
+  noInterrupts();
+  accCount++;
+  interrupts();
+
+} // RegisterListBase::queueAccessory()
+#endif
+
+#ifdef ACCESSORY_STATE
+///////////////////////////////////////////////////////////////////////////////
+
+// <N ADDRESS COUNT>: one hex digit per decoder address, bit 0 for subaddress 0
+
+void RegisterListBase::printAccessoryState(char *s){
+  int aAdd, n, i;
+
+  if(sscanf(s,"%d %d",&aAdd,&n)!=2 || aAdd<0 || n<1 || aAdd+n>512){
+    INTERFACE.print(F("<X>"));
+    return;
+  }
+  INTERFACE.print(F("<n "));
+  INTERFACE.print(aAdd);
+  INTERFACE.print(F(" "));
+  for(i=aAdd;i<aAdd+n;i++)
+    INTERFACE.print((accessoryState[i/2]>>((i%2)*4))&0x0F,HEX);
+  INTERFACE.print(F(">"));
+
+} // RegisterListBase::printAccessoryState()
+
+#ifdef ACCESSORY_REFRESH
+///////////////////////////////////////////////////////////////////////////////
+
+// Called from loop(): every ACCESSORY_REFRESH ms the next output that has been sent
+// an <a> gets its last state again, once, for decoders that missed it.  Skipped while
+// register 0 (or accQueue) is busy so loop() never waits here.
+
+void RegisterListBase::refreshAccessory() volatile{
+  int i, n;
+
+#ifdef ACCESSORY_QUEUE
+  if((unsigned long)(tickCounter-refreshTick) < ACCESSORY_REFRESH*250UL || accCount>0)
+    return;
+#else
+  if((unsigned long)(tickCounter-refreshTick) < ACCESSORY_REFRESH*250UL || nextReg!=NULL)
+    return;
+#endif
+  refreshTick=tickCounter;
+
+  for(n=0;n<ACCESSORY_STATE_BYTES*8;n++){
+    i=(refreshIndex+1+n)%(ACCESSORY_STATE_BYTES*8);
+    if(accessoryKnown[i/8] & (1<<(i%8))){
+      refreshIndex=i;
+      loadAccessory(i/4,i%4,(accessoryState[i/8]>>(i%8))&1,1);
+      return;
+    }
+  }
+
+} // RegisterListBase::refreshAccessory()
+#endif
+#endif
 
 ///////////////////////////////////////////////////////////////////////////////
 
-void RegisterList::writeTextPacket(char *s) volatile{
+void RegisterListBase::writeTextPacket(char *s) volatile{
   
   int nReg;
   byte b[6];
+  unsigned int v[5];           // %x stores an unsigned int, not a byte
   int nBytes;
     
-  nBytes=sscanf(s,"%d %x %x %x %x %x",&nReg,b,b+1,b+2,b+3,b+4)-1;
+  nBytes=sscanf(s,"%d %x %x %x %x %x",&nReg,v,v+1,v+2,v+3,v+4)-1;
   
   if(nBytes<2 || nBytes>5){    // invalid valid packet
     INTERFACE.print(F("<mInvalid Packet>"));
     return;
   }
+  for(int i=0;i<nBytes;i++)
+    b[i]=v[i];
          
   loadPacket(nReg,b,nBytes,0,1);
     
-} // RegisterList::writeTextPacket()
+} // RegisterListBase::writeTextPacket()
 
 ///////////////////////////////////////////////////////////////////////////////
 
-/* ackdetect side-effect: Will restore resetPacket to slot 1 */
+/* ackdetect side-effect: Will restore resetPacket to slot 1                             */
+/* Times the pulse by counting the samples of the Sampler, micros() does not run on the */
+/* Uno where timer0 generates the Programming Track signal                              */
 
-byte RegisterList::ackdetect(unsigned int base) volatile{
-    byte upflankFound = 0;
+byte RegisterListBase::ackdetect() volatile{
     byte ackFound = 0;
-    int c = 0;
-    byte searchLowflank = 1;
+    byte high = 0;                                         // current is above the threshold
+    byte n = 0;                                            // consecutive samples on the other side of the threshold
     unsigned int current;
+    unsigned int base;
+    unsigned int peak = 0;
+    unsigned int threshold = ackStats.threshold;
+    byte count, now;                                       // Sampler::progCount of the last and the new sample
+    unsigned int sampleTime = 0;                           // samples since the start, SAMPLER_PROG_PERIOD_US each,
+    unsigned int edgeTime = 0;                             // 16 bits as a byte would wrap after 26.6ms
+    unsigned int upflankTime = 0;
     unsigned long acktime;
-    unsigned long upflankTickCounter;
-    unsigned long lowflankTickCounter;
     unsigned long oldPacketCounter;
 
     oldPacketCounter = packetsTransmitted; // remember time when we started
+    count = Sampler::progCount;
     for(;;){
+      while ((now = Sampler::progCount) == count);         // wait for the next sample
+      sampleTime += (byte)(now - count);                   // 1, more after a bandgap dwell or if we were slow
+      count = now;
       current = progMonitor.read();
-      if (base > current)
-	  current = base;                    // prevent negative values - XXX c, current, base can be written simpler later
+      base = progMonitor.quiescent();
+      current = current > base ? current - base : 0;       // prevent negative values
 #ifdef DEBUGACK
-      INTERFACE.print(current-base); INTERFACE.print(".");
+      INTERFACE.print(current); INTERFACE.print(".");
 #endif
-      c=(current-base)/**ACK_SAMPLE_SMOOTHING+c*(1.0-ACK_SAMPLE_SMOOTHING)*/; /* I don't believe in smoothing here */
-      if(upflankFound != 1 ) {
-        if (c>ACK_SAMPLE_THRESHOLD) {
-	  upflankFound=1;                                  // upflank found, set flag
-	  upflankTickCounter=tickCounter;                  // remember time when we got the upflank
+      if (!ackFound) {
+        // falling edge at half the threshold, so noise on top of the ACK does not split it
+        if ((current >= (high ? threshold/2 : threshold)) != high) {
+          if (n++ == 0)
+            edgeTime = sampleTime;                         // the first sample past the threshold dates the edge
+          if (n >= ACK_DEBOUNCE) {
+            high = !high;
+            n = 0;
+            if (high) {                                    // upflank
+              upflankTime = edgeTime;
+              peak = 0;
 #ifdef DEBUGACK
-	  INTERFACE.print("^");
+              INTERFACE.print("^");
 #endif
-	}
-      } else {                                             // upflankFound == 1
-        if (searchLowflank && c<ACK_SAMPLE_THRESHOLD) {    // lowflank found
-	  lowflankTickCounter = tickCounter;
-	  searchLowflank= 0;
-	  acktime = (unsigned long)(lowflankTickCounter - upflankTickCounter);
+            } else {                                       // lowflank
+              acktime = (unsigned long)(edgeTime - upflankTime) * SAMPLER_PROG_PERIOD_US;
 #ifdef DEBUGACK
-	  INTERFACE.print("v"); INTERFACE.print(acktime*4); INTERFACE.print("v");
+              INTERFACE.print("v"); INTERFACE.print(acktime); INTERFACE.print("v");
 #endif
-	  if (acktime < 1125 || acktime > 2125) {         // 1125*4=4500us 2125*4=8500us but our measurement is quite flaky
-	    upflankFound = 0;
-	    searchLowflank = 1;
-	  } else {
-	    ackFound = 1;
-	    loadPacket(1,resetPacket,2,1);                   // go back to transmitting reset packets
-	    oldPacketCounter = packetsTransmitted;           // remember time when we got the Ack, leave loop below later
-	  }
-	}
+              if (acktime < ACK_MIN_WIDTH || acktime > ACK_MAX_WIDTH + SAMPLER_WINDOW_US) {   // the averaging widens the pulse
+                ackStats.nFalse++;
+              } else {
+                ackFound = 1;
+                ackStats.nAcks++;
+                ackStats.sumWidth += acktime;
+                if (acktime < ackStats.minWidth)
+                  ackStats.minWidth = acktime;
+                if (acktime > ackStats.maxWidth)
+                  ackStats.maxWidth = acktime;
+                if (peak > ackStats.maxPeak)
+                  ackStats.maxPeak = peak;
+                loadPacket(1,resetPacket,2,1);             // go back to transmitting reset packets
+                oldPacketCounter = packetsTransmitted;     // remember time when we got the Ack, leave loop below later
+              }
+            }
+          }
+        } else {
+          if (n)                                           // spike shorter than ACK_DEBOUNCE samples
+            ackStats.nFalse++;
+          n = 0;
+        }
+        if (high && current > peak)
+          peak = current;
       }
       if(ackFound && (unsigned long)(packetsTransmitted - oldPacketCounter) >= 3) { // wait for at least 3 packets after detected Ack
 #ifdef DEBUGACK
@@ -306,22 +496,26 @@ byte RegisterList::ackdetect(unsigned int base) volatile{
 #ifdef DEBUGACK
 	INTERFACE.print(packetsTransmitted); INTERFACE.print("X");
 #endif
+        if (!ackFound)
+          ackStats.nNoAcks++;
 	return ackFound;                              // timeout, maybe no Ack found
       }
     }
     /* should never reach here as there is a for(;;) above */
-} // RegisterList::ackdetect(int)
+} // RegisterListBase::ackdetect(int)
   
 ///////////////////////////////////////////////////////////////////////////////
 
 /* power up sequence: Check if we need to turn on rail power and if we do */
 /* tell caller so that caller can turn off rail power later               */
 
-byte RegisterList::poweron() volatile {
+byte RegisterListBase::poweron() volatile {
   byte turnoff = 0;
   byte numpackets = 3;                                   // 3 packets default wait
   unsigned long oldPacketCounter;
 
+  if (progTrackJoined != DCC_JOIN_OFF)                   // back to service mode, otherwise
+    unjoinProgTrack();                                   // no packets of ours are sent
   if (digitalRead(SIGNAL_ENABLE_PIN_PROG) == LOW) {
     turnoff = 1;
     numpackets = 20;                                     // 20 packets poweron wait
@@ -331,134 +525,318 @@ byte RegisterList::poweron() volatile {
   loadPacket(1,resetPacket,2,1);
   while ((unsigned long)(packetsTransmitted - oldPacketCounter) < numpackets); // busy wait
   return turnoff;
-} // RegisterList::poweron()
+} // RegisterListBase::poweron()
+
+///////////////////////////////////////////////////////////////////////////////
+
+/* Measures the noise of the current above the quiescent current, from which the ACK threshold follows */
+
+void RegisterListBase::readBaseNoise() volatile {
+  unsigned int current, base, lo=0xFFFF, hi=0;
+  unsigned int threshold;
+  byte count=Sampler::progCount;
+
+  for(int j=0;j<ACK_BASE_COUNT;j++){
+    while(Sampler::progCount==count);      // wait for the next sample
+    count=Sampler::progCount;
+    current=progMonitor.read();
+    base=progMonitor.quiescent();
+    current=current>base ? current-base : 0;
+    if(current<lo)
+      lo=current;
+    if(current>hi)
+      hi=current;
+  }
+  ackStats.noise=(hi-lo)/2;
+  threshold=ACK_THRESHOLD_MIN+ACK_NOISE_FACTOR*ackStats.noise;
+  ackStats.threshold=min(threshold,ACK_SAMPLE_THRESHOLD);
+} // RegisterListBase::readBaseNoise()
+
+///////////////////////////////////////////////////////////////////////////////
+
+/* Everything a Programming Track command needs before its first packet: power and the */
+/* ACK threshold.  Inside a <G> session both are already there, but a <J 1> since then */
+/* must be undone.  Returns what poweron() returns, to be handed to progTrackOff()      */
+
+byte RegisterListBase::progTrackOn() volatile {
+  progSessionCheck();
+  if(sessionOpen){
+    if (progTrackJoined != DCC_JOIN_OFF)                 // back to service mode, as poweron() does
+      unjoinProgTrack();
+    return 0;
+  }
+  byte turnoff=poweron();
+  readBaseNoise();
+  return turnoff;
+} // RegisterListBase::progTrackOn()
+
+void RegisterListBase::progTrackOff(byte turnoff) volatile {
+  if (turnoff)
+    digitalWrite(SIGNAL_ENABLE_PIN_PROG,LOW);
+} // RegisterListBase::progTrackOff()
+
+/* The <G 1> session ends when the Programming Track loses its power, by <0> or a short */
+
+void RegisterListBase::progSessionCheck(){
+  if(sessionOpen && digitalRead(SIGNAL_ENABLE_PIN_PROG)==LOW){
+    sessionOpen=0;
+    INTERFACE.print(F("<g 0>"));
+  }
+} // RegisterListBase::progSessionCheck()
+
+///////////////////////////////////////////////////////////////////////////////
+
+void RegisterListBase::printCV(int callBack, int callBackSub, int cv, int bValue){
+  INTERFACE.print(F("<r"));
+  INTERFACE.print(callBack);
+  INTERFACE.print(F("|"));
+  INTERFACE.print(callBackSub);
+  INTERFACE.print(F("|"));
+  INTERFACE.print(cv);
+  INTERFACE.print(F(" "));
+  INTERFACE.print(bValue);
+  INTERFACE.print(F(">"));
+} // RegisterListBase::printCV()
+
+///////////////////////////////////////////////////////////////////////////////
+
+/* Byte verify: returns 1 if the decoder acknowledges that CV cv (0-1023) has value */
+
+byte RegisterListBase::verifyCVByte(int cv, byte value) volatile{
+  byte bRead[4];
+
+  bRead[0]=0x74+(highByte(cv)&0x03);      // any CV>1023 will become modulus(1024) due to bit-mask of 0x03
+  bRead[1]=lowByte(cv);
+  bRead[2]=value;
+  loadPacket(0,resetPacket,2,3);          // NMRA recommends starting with 3 reset packets
+  loadPacket(1,bRead,3,1);                // Start transmitting verify packets (according to NMRA at least 5 
+                                          // but we do it continiously until Ack or timeout
+  return ackdetect();
+} // RegisterListBase::verifyCVByte()
 
 ///////////////////////////////////////////////////////////////////////////////
 
-unsigned int RegisterList::readBaseCurrent() volatile {
-  unsigned int base=0;
-  /* read base current */
-  for(int j=0;j<ACK_BASE_COUNT;j++)
-    base+=progMonitor.read();
-  base/=ACK_BASE_COUNT;
-  return base;
-} // RegisterList::readBaseCurrent()
+/* Bitwise read of CV cv (0-1023): 8 bit verifies followed by a byte verify, returns -1 on failure */
 
-void RegisterList::readCV(char *s) volatile{
+int RegisterListBase::readCVBits(int cv) volatile{
   byte bRead[4];
   int bValue;
-  byte d;                            // tmp var for holding ackdetect answer
-  unsigned int base;                 // measured base current before ack
-  int cv, callBack, callBackSub;
-  byte turnoff;                      // need to turn off power again
+  byte d;                                   // tmp var for holding ackdetect answer
 
-  if(sscanf(s,"%d %d %d",&cv,&callBack,&callBackSub)!=3)          // cv = 1-1024
-    return;    
-  cv--;                              // actual CV addresses are cv-1 (0-1023)
-  
-  bRead[0]=0x78+(highByte(cv)&0x03);   // any CV>1023 will become modulus(1024) due to bit-mask of 0x03
+  bRead[0]=0x78+(highByte(cv)&0x03);        // any CV>1023 will become modulus(1024) due to bit-mask of 0x03
   bRead[1]=lowByte(cv);
   
   bValue=0;
 
-  turnoff = poweron();
-  base=readBaseCurrent();
-
   for(int i=0;i<8;i++){                     // check all 8 bits
     bRead[2]=0xE8+i;  
 
     loadPacket(0,resetPacket,2,3);          // NMRA recommends starting with 3 reset packets
     loadPacket(1,bRead,3,1);                // Start transmitting verify packets (according to NMRA at least 5 )
                                             // but we do it continiously until Ack or timeout
-    d = ackdetect(base);
+    d = ackdetect();
     bitWrite(bValue,i,d);                   // write the found bit into bValue
   }                                         // end loop over bits
 
-  bRead[0]=0x74+(highByte(cv)&0x03);      // set-up to re-verify entire byte
-  bRead[2]=bValue;  
-  loadPacket(0,resetPacket,2,3);          // NMRA recommends starting with 3 reset packets
-  loadPacket(1,bRead,3,1);                // Start transmitting verify packets (according to NMRA at least 5 
-                                          // but we do it continiously until Ack or timeout
-  d = ackdetect(base);
-
-  if(d==0)    // verify unsuccessful
+  if(verifyCVByte(cv,bValue)==0)       // re-verify entire byte
     bValue=-1;
-  INTERFACE.print(F("<r"));
-  INTERFACE.print(callBack);
-  INTERFACE.print(F("|"));
-  INTERFACE.print(callBackSub);
-  INTERFACE.print(F("|"));
-  INTERFACE.print(cv+1);
-  INTERFACE.print(F(" "));
-  INTERFACE.print(bValue);
-  INTERFACE.print(F(">"));
-  if (turnoff)
-    digitalWrite(SIGNAL_ENABLE_PIN_PROG,LOW);
+  return bValue;
+} // RegisterListBase::readCVBits()
+
+///////////////////////////////////////////////////////////////////////////////
+
+/* Read of CV cv (0-1023), with a byte verify of guess first if that is 0-255, returns -1 on failure */
+
+int RegisterListBase::readCVValue(int cv, int guess) volatile{
+  int bValue;
+
+  if(guess>=0 && guess<=255 && verifyCVByte(cv,guess))
+    bValue=guess;                    // lucky, one verify instead of nine
+  else
+    bValue=readCVBits(cv);
+  cvCachePut(cv+1,bValue);
+  return bValue;
+} // RegisterListBase::readCVValue()
+
+///////////////////////////////////////////////////////////////////////////////
+
+void RegisterListBase::readCV(char *s) volatile{
+  int bValue;
+  int guess;                         // value to try with a single byte verify first, -1 = none
+  int cv, callBack, callBackSub;
+  byte turnoff;                      // need to turn off power again
+
+  switch(sscanf(s,"%d %d %d %d",&cv,&callBack,&callBackSub,&guess)){  // cv = 1-1024
+    case 3:
+      guess=cvCacheGet(cv);
+      break;
+    case 4:
+      break;
+    default:
+      return;
+  }
+  cv--;                              // actual CV addresses are cv-1 (0-1023)
+
+  turnoff = progTrackOn();
+  bValue=readCVValue(cv,guess);
+  printCV(callBack,callBackSub,cv+1,bValue);
+  progTrackOff(turnoff);
         
-} // RegisterList::readCV()
+} // RegisterListBase::readCV()
+
+///////////////////////////////////////////////////////////////////////////////
+
+/* <G 1> opens a session, <G 0> closes it, <G FIRST LAST CALLBACKNUM CALLBACKSUB> reads */
+/* a range of CVs, inside the session if there is one, otherwise in its own             */
+
+void RegisterListBase::progSession(char *s) volatile{
+  int n, last, callBack, callBackSub;
+  byte turnoff;
+
+  progSessionCheck();
+  switch(sscanf(s,"%d %d %d %d",&n,&last,&callBack,&callBackSub)){
+    case 1:
+      if(n==1 && !sessionOpen){
+        clearAckStats();
+        sessionTurnoff=poweron();
+        readBaseNoise();
+        sessionOpen=1;
+      } else if(n==0 && sessionOpen){
+        sessionOpen=0;
+        progTrackOff(sessionTurnoff);
+      }
+      break;
+    case 4:
+      if(n<1 || last>1024 || last<n){
+        INTERFACE.print(F("<X>"));                      // nothing to read, but the host waits for an answer
+        return;
+      }
+      turnoff=progTrackOn();
+      for(;n<=last;n++){
+        printCV(callBack,callBackSub,n,readCVValue(n-1,cvCacheGet(n)));
+      }
+      progTrackOff(turnoff);
+      return;
+    default:
+      break;
+  }
+  INTERFACE.print(F("<g "));
+  INTERFACE.print(sessionOpen);
+  INTERFACE.print(F(">"));
+} // RegisterListBase::progSession()
+
+///////////////////////////////////////////////////////////////////////////////
+
+void RegisterListBase::clearAckStats(){
+  unsigned int noise=ackStats.noise;
+  unsigned int threshold=ackStats.threshold;
+
+  memset(&ackStats,0,sizeof(ackStats));
+  ackStats.minWidth=0xFFFF;
+  ackStats.noise=noise;                     // these describe the track, not the session
+  ackStats.threshold=threshold;
+} // RegisterListBase::clearAckStats()
+
+/* Prints <A ACKS NOACKS FALSE MINWIDTH AVGWIDTH MAXWIDTH PEAK NOISE THRESHOLD> */
+
+void RegisterListBase::printAckStats(){
+  INTERFACE.print(F("<A "));
+  INTERFACE.print(ackStats.nAcks); INTERFACE.print(F(" "));
+  INTERFACE.print(ackStats.nNoAcks); INTERFACE.print(F(" "));
+  INTERFACE.print(ackStats.nFalse); INTERFACE.print(F(" "));
+  if(ackStats.nAcks){
+    INTERFACE.print(ackStats.minWidth); INTERFACE.print(F(" "));
+    INTERFACE.print(ackStats.sumWidth/ackStats.nAcks); INTERFACE.print(F(" "));
+    INTERFACE.print(ackStats.maxWidth); INTERFACE.print(F(" "));
+  } else {
+    INTERFACE.print(F("0 0 0 "));
+  }
+  INTERFACE.print(ackStats.maxPeak); INTERFACE.print(F(" "));
+  INTERFACE.print(ackStats.noise); INTERFACE.print(F(" "));
+  INTERFACE.print(ackStats.threshold);
+  INTERFACE.print(F(">"));
+} // RegisterListBase::printAckStats()
+
+///////////////////////////////////////////////////////////////////////////////
+
+/* Small cache of CV values seen on the Programming Track, used as guess by readCV() */
+
+int RegisterListBase::cvCacheGet(int cv){
+  for(byte i=0;i<CV_CACHE_SIZE;i++)
+    if(cvCache[i].cv==cv)
+      return cvCache[i].value;
+  return -1;
+} // RegisterListBase::cvCacheGet()
+
+void RegisterListBase::cvCachePut(int cv, int value){
+  byte i;
+
+  for(i=0;i<CV_CACHE_SIZE;i++)              // replace an older entry of the same CV
+    if(cvCache[i].cv==cv)
+      break;
+  if(value<0){                              // value unknown, forget the CV
+    if(i<CV_CACHE_SIZE)
+      cvCache[i].cv=0;
+    return;
+  }
+  if(i==CV_CACHE_SIZE){
+    i=cvCacheNext;
+    cvCacheNext=(cvCacheNext+1)%CV_CACHE_SIZE;
+  }
+  cvCache[i].cv=cv;
+  cvCache[i].value=value;
+} // RegisterListBase::cvCachePut()
 
 ///////////////////////////////////////////////////////////////////////////////
 
-void RegisterList::writeCVByte(char *s) volatile{
+void RegisterListBase::writeCVByte(char *s) volatile{
   byte bWrite[4];
   byte turnoff;
   int bValue;
   byte d;
-  unsigned int base;
   int cv, callBack, callBackSub;
 
   if(sscanf(s,"%d %d %d %d",&cv,&bValue,&callBack,&callBackSub)!=4)          // cv = 1-1024
     return;    
   cv--;                              // actual CV addresses are cv-1 (0-1023)
 
-  turnoff = poweron();
-  base=readBaseCurrent();
+  turnoff = progTrackOn();
   
   bWrite[0]=0x7C+(highByte(cv)&0x03);   // any CV>1023 will become modulus(1024) due to bit-mask of 0x03
   bWrite[1]=lowByte(cv);
   bWrite[2]=bValue;
   loadPacket(1,bWrite,3,1);
-  d = ackdetect(base);
+  d = ackdetect();
 
   if (d == 0) { // we did not get ack on the write, try do do a traditional verify
     bWrite[0]=0x74+(highByte(cv)&0x03);   // set-up to re-verify entire byte
     loadPacket(1,bWrite,3,1);
-    d = ackdetect(base);
+    d = ackdetect();
   }
 
   if(d==0)    // verify unsuccessful
     bValue=-1;
+  cvCachePut(cv+1,bValue);
 
-  INTERFACE.print(F("<r"));
-  INTERFACE.print(callBack);
-  INTERFACE.print(F("|"));
-  INTERFACE.print(callBackSub);
-  INTERFACE.print(F("|"));
-  INTERFACE.print(cv+1);
-  INTERFACE.print(F(" "));
-  INTERFACE.print(bValue);
-  INTERFACE.print(F(">"));
-  if (turnoff)
-    digitalWrite(SIGNAL_ENABLE_PIN_PROG,LOW);
+  printCV(callBack,callBackSub,cv+1,bValue);
+  progTrackOff(turnoff);
 
-} // RegisterList::writeCVByte()
+} // RegisterListBase::writeCVByte()
   
 ///////////////////////////////////////////////////////////////////////////////
 
-void RegisterList::writeCVBit(char *s) volatile{
+void RegisterListBase::writeCVBit(char *s) volatile{
   byte bWrite[4];
   byte turnoff;
   int bNum,bValue;
   byte d;
-  unsigned int base;
   int cv, callBack, callBackSub;
 
   if(sscanf(s,"%d %d %d %d %d",&cv,&bNum,&bValue,&callBack,&callBackSub)!=5)          // cv = 1-1024
     return;    
   cv--;                              // actual CV addresses are cv-1 (0-1023)
 
-  turnoff = poweron();
-  base=readBaseCurrent();
+  turnoff = progTrackOn();
 
   bValue=bValue%2;
   bNum=bNum%8;
@@ -466,18 +844,19 @@ void RegisterList::writeCVBit(char *s) volatile{
   bWrite[1]=lowByte(cv);  
   bWrite[2]=0xF0+bValue*8+bNum;
   loadPacket(1,bWrite,3,1);
-  d = ackdetect(base);
+  d = ackdetect();
 
   if (d == 0) {                          // did not get ack from write and need to verify
   
     bitClear(bWrite[2],4);               // change instruction code from Write Bit to Verify Bit
 
     loadPacket(1,bWrite,3,1);
-    d = ackdetect(base);
+    d = ackdetect();
   }
     
   if(d==0)    // verify unsuccessful
     bValue=-1;
+  cvCachePut(cv+1,-1);               // other bits unknown here, forget the CV
   
   INTERFACE.print(F("<r"));
   INTERFACE.print(callBack);
@@ -490,14 +869,13 @@ void RegisterList::writeCVBit(char *s) volatile{
   INTERFACE.print(F(" "));
   INTERFACE.print(bValue);
   INTERFACE.print(F(">"));
-  if (turnoff)
-    digitalWrite(SIGNAL_ENABLE_PIN_PROG,LOW);
+  progTrackOff(turnoff);
 
-} // RegisterList::writeCVBit()
+} // RegisterListBase::writeCVBit()
   
 ///////////////////////////////////////////////////////////////////////////////
 
-void RegisterList::writeCVByteMain(char *s) volatile{
+void RegisterListBase::writeCVByteMain(char *s) volatile{
   byte b[6];                      // save space for checksum byte
   int cab;
   int cv;
@@ -518,11 +896,11 @@ void RegisterList::writeCVByteMain(char *s) volatile{
     
   loadPacket(0,b,nB,4);
 
-} // RegisterList::writeCVByteMain()
+} // RegisterListBase::writeCVByteMain()
   
 ///////////////////////////////////////////////////////////////////////////////
 
-void RegisterList::writeCVBitMain(char *s) volatile{
+void RegisterListBase::writeCVBitMain(char *s) volatile{
   byte b[6];                      // save space for checksum byte
   int cab;
   int cv;
@@ -547,11 +925,50 @@ void RegisterList::writeCVBitMain(char *s) volatile{
     
   loadPacket(0,b,nB,4);
   
-} // RegisterList::writeCVBitMain()
+} // RegisterListBase::writeCVBitMain()
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef RAILCOM_RECEIVER
+void RegisterListBase::readCVMain(char *s) volatile{
+  byte b[6];                      // save space for checksum byte
+  int cab, cv, callBack, callBackSub;
+  int bValue=-1;
+  byte nB=0;
+  unsigned long start;
+
+  if(sscanf(s,"%d %d %d %d",&cab,&cv,&callBack,&callBackSub)!=4)
+    return;
+  cv--;
+
+  if(cab>127)
+    b[nB++]=highByte(cab) | 0xC0;      // convert train number into a two-byte address
+
+  b[nB++]=lowByte(cab);
+  b[nB++]=0xE4+(highByte(cv)&0x03);   // verify byte: the decoder answers with the CV value in RailCom channel 2
+  b[nB++]=lowByte(cv);
+  b[nB++]=0;
+
+  RailCom::check();                   // forget answers to earlier packets
+  RailCom::datagram.cab=0;
+  start=tickCounter;
+  loadPacket(0,b,nB,4);
+  while((unsigned long)(tickCounter-start) < RAILCOM_POM_TIMEOUT){  // busy wait for the answer
+    RailCom::check();
+    if(RailCom::datagram.cab==cab && RailCom::datagram.id==RAILCOM_ID_POM && RailCom::datagram.nBits==8){
+      bValue=RailCom::datagram.data;
+      break;
+    }
+  }
+
+  printCV(callBack,callBackSub,cv+1,bValue);
+
+} // RegisterListBase::readCVMain()
+#endif
 
 ///////////////////////////////////////////////////////////////////////////////
 
-void RegisterList::printPacket(int nReg, byte *b, int nBytes, int nRepeat) volatile {
+void RegisterListBase::printPacket(int nReg, byte *b, int nBytes, int nRepeat) volatile {
   
   INTERFACE.print(F("<*"));
   INTERFACE.print(nReg);
@@ -563,11 +980,11 @@ void RegisterList::printPacket(int nReg, byte *b, int nBytes, int nRepeat) volat
   INTERFACE.print(F(" / "));
   INTERFACE.print(nRepeat);
   INTERFACE.print(F(">"));
-} // RegisterList::printPacket()
+} // RegisterListBase::printPacket()
 
 ///////////////////////////////////////////////////////////////////////////////
 
-void RegisterList::printMaxNumRegs() volatile {
+void RegisterListBase::printMaxNumRegs() volatile {
       INTERFACE.print(F("<#"));
       INTERFACE.print(maxNumRegs);
       INTERFACE.print(F(">"));
@@ -575,7 +992,98 @@ void RegisterList::printMaxNumRegs() volatile {
 }
 ///////////////////////////////////////////////////////////////////////////////
 
-byte RegisterList::idlePacket[3]={0xFF,0x00,0};                 // always leave extra byte for checksum computation
-byte RegisterList::resetPacket[3]={0x00,0x00,0};
+#ifdef REGISTER_STATS
+
+void RegisterListBase::clearStats() volatile {
+  noInterrupts();
+  for(int i=0;i<=maxNumRegs;i++){
+    stats[i].restart=1;
+    stats[i].count=0;
+    stats[i].sumGap=0;
+    stats[i].nGaps=0;
+    stats[i].minGap=0xFFFF;
+    stats[i].maxGap=0;
+  }
+  statsStartTick=tickCounter;
+  statsStartPackets=packetsTransmitted;
+  oneShotPackets=0;
+  interrupts();
+} // RegisterListBase::clearStats()
+
+///////////////////////////////////////////////////////////////////////////////
+
+/* Prints <U REG COUNT MIN AVG MAX> for every register in use, refresh      */
+/* intervals in ms, followed by <U PACKETS/S ONESHOT% USED MAX_REGISTERS>   */
+
+void RegisterListBase::printStats() volatile {
+  unsigned long ms;
+  unsigned long packets;
+  RegisterStats s;
+  int used=0;
+
+  noInterrupts();
+  ms=(unsigned long)(tickCounter-statsStartTick)/250;   // 250 ticks per ms
+  packets=packetsTransmitted-statsStartPackets;
+  interrupts();
+  if(ms==0)
+    ms=1;
+
+  for(int n=1;n<=maxNumRegs;n++){
+    if(regMap[n]==NULL)
+      continue;
+    used++;
+    noInterrupts();
+    s=stats[regMap[n]-reg];
+    interrupts();
+    INTERFACE.print(F("<U"));
+    INTERFACE.print(n); INTERFACE.print(F(" "));
+    INTERFACE.print(s.count); INTERFACE.print(F(" "));
+    if(s.nGaps==0){                                     // no interval measured yet
+      INTERFACE.print(F("0 0 0>"));
+      continue;
+    }
+    INTERFACE.print(((unsigned long)s.minGap<<REGISTER_STATS_SHIFT)/250); INTERFACE.print(F(" "));
+    INTERFACE.print(((s.sumGap/s.nGaps)<<REGISTER_STATS_SHIFT)/250); INTERFACE.print(F(" "));
+    INTERFACE.print(((unsigned long)s.maxGap<<REGISTER_STATS_SHIFT)/250);
+    INTERFACE.print(F(">"));
+  }
+  INTERFACE.print(F("<U"));
+  if(packets<0xFFFFFFFFUL/1000)
+    INTERFACE.print(packets*1000/ms);
+  else                                                  // packets*1000 would overflow, but then ms is large
+    INTERFACE.print(packets/(ms/1000));
+  INTERFACE.print(F(" "));
+  INTERFACE.print(packets ? oneShotPackets*100/packets : 0); INTERFACE.print(F(" "));
+  INTERFACE.print(used); INTERFACE.print(F(" "));
+  INTERFACE.print(maxNumRegs);
+  INTERFACE.print(F(">"));
+} // RegisterListBase::printStats()
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+byte RegisterListBase::idlePacket[3]={0xFF,0x00,0};                 // always leave extra byte for checksum computation
+byte RegisterListBase::resetPacket[3]={0x00,0x00,0};
+
+#ifdef ACCESSORY_QUEUE
+AccessoryPacket RegisterListBase::accQueue[ACCESSORY_QUEUE];
+volatile byte RegisterListBase::accHead=0;
+volatile byte RegisterListBase::accCount=0;
+unsigned long RegisterListBase::accLastTick=0;
+#endif
+#ifdef ACCESSORY_STATE
+byte RegisterListBase::accessoryState[ACCESSORY_STATE_BYTES];
+#ifdef ACCESSORY_REFRESH
+byte RegisterListBase::accessoryKnown[ACCESSORY_STATE_BYTES];
+int RegisterListBase::refreshIndex=-1;
+unsigned long RegisterListBase::refreshTick=0;
+#endif
+#endif
+byte RegisterListBase::bitMask[]={0x80,0x40,0x20,0x10,0x08,0x04,0x02,0x01};         // masks used in interrupt routine to speed the query of a single bit in a Packet
 
-byte RegisterList::bitMask[]={0x80,0x40,0x20,0x10,0x08,0x04,0x02,0x01};         // masks used in interrupt routine to speed the query of a single bit in a Packet
+byte RegisterListBase::sessionOpen=0;
+byte RegisterListBase::sessionTurnoff;
+CVCacheEntry RegisterListBase::cvCache[CV_CACHE_SIZE];                                 // CVs read or written on the Programming Track
+byte RegisterListBase::cvCacheNext=0;
+AckStats RegisterListBase::ackStats={0,0,0,0xFFFF,0,0,0,0,ACK_SAMPLE_THRESHOLD};
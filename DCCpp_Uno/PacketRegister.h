@@ -13,23 +13,88 @@ Part of DCC++ BASE STATION for the Arduino
 
 #include "Arduino.h"
 #include "CurrentMonitor.h"
+#include "Sampler.h"
 
 // Define constants used for reading CVs from the Programming Track
 
-#define  ACK_BASE_COUNT            100      // number of analogRead samples to take before each CV verify to establish a baseline current
+#define  ACK_BASE_COUNT            100      // number of current samples to take before each CV verify to establish the noise of the baseline current
 #define  ACK_SAMPLE_SMOOTHING      0.7      // exponential smoothing to use in processing the analogRead samples after a CV verify (bit or byte) has been sent
 #define  ACK_SAMPLE_THRESHOLD       55      // the threshold that the exponentially-smoothed analogRead samples 
                                             // (after subtracting the baseline current) must cross to establish ACKNOWLEDGEMENT
                                             // The value is when taken from CurrentMonitor::read() in mA.
+#define  ACK_THRESHOLD_MIN          30      // mA, the threshold actually used is ACK_THRESHOLD_MIN plus ACK_NOISE_FACTOR times
+#define  ACK_NOISE_FACTOR            3      // the noise of the baseline current, but never more than ACK_SAMPLE_THRESHOLD
+#define  ACK_DEBOUNCE                2      // number of consecutive samples that must be past the threshold to count as an edge
+#define  ACK_MIN_WIDTH            4500      // shortest ACK pulse accepted in us (NMRA S-9.2.3: 6ms +-1ms, plus sampling margin)
+#define  ACK_MAX_WIDTH            8500      // longest ACK pulse accepted in us
+#define  CV_CACHE_SIZE               8      // number of CV values read or written on the Programming Track that are
+                                            // remembered as first guess for the next read of the same CV
 
 // Define a series of registers that can be sequentially accessed over a loop to generate a repeating series of DCC Packets
 
+#ifdef COMPACT_REGISTERS
+// Only the packet bytes are kept, the checksum and the start and end bits are added
+// by the interrupt routine while the packet is sent.
+#define REGISTER_INVALID 0x80       // flag in nBytes
+
+struct Register{
+  byte buf[5];   /* 2-5 bytes of DCC data, without checksum */
+  byte nBytes;   /* number of bytes in buf + REGISTER_INVALID flag */
+}; // Packet, for now named Register 
+#else
 struct Register{
   byte buf[7];   /* 56 bits: 6*8=48 bits of DCC data + 7 start/stop bits + 1 internal flag bit */
   byte nBits;
 }; // Packet, for now named Register 
-  
-struct RegisterList{  
+#endif
+
+struct CVCacheEntry{
+  int cv;                           // 1-1024, 0 = unused
+  byte value;
+};
+
+struct AckStats{                    // ACK detection since the last <A 0> or <G 1>
+  unsigned int nAcks;
+  unsigned int nNoAcks;             // verifies that timed out without an ACK
+  unsigned int nFalse;              // edges that did not make an ACK: spikes, pulses too short or too long
+  unsigned int minWidth;            // ACK pulse width in us
+  unsigned int maxWidth;
+  unsigned long sumWidth;
+  unsigned int maxPeak;             // highest current above base during an ACK in mA
+  unsigned int noise;               // of the last baseline current measurement in mA
+  unsigned int threshold;           // in use, in mA above base
+};
+
+#ifdef REGISTER_STATS
+#define REGISTER_STATS_SHIFT 4      // refresh intervals are kept in units of 2^4 ticks = 64us
+
+struct RegisterStats{
+  unsigned long lastTick;           // tickCounter when this slot was last transmitted
+  unsigned long count;              // number of transmissions since the stats were cleared
+  unsigned long sumGap;             // of all refresh intervals measured (units of 2^REGISTER_STATS_SHIFT ticks)
+  unsigned long nGaps;              // refresh intervals measured, fewer than count-1 after restarts
+  unsigned int minGap;              // shortest refresh interval (units of 2^REGISTER_STATS_SHIFT ticks)
+  unsigned int maxGap;              // longest refresh interval  (units of 2^REGISTER_STATS_SHIFT ticks)
+  byte restart;                     // lastTick is not valid, the next transmission starts an interval
+};
+#endif
+
+#ifdef ACCESSORY_STATE
+#define ACCESSORY_STATE_BYTES  256  // one bit for each of the 512*4 accessory outputs, bit ADDRESS*4+SUBADDRESS
+#endif
+
+#ifdef ACCESSORY_QUEUE
+struct AccessoryPacket{             // waiting in RegisterListBase::accQueue
+  Register reg;                     // encoded as by loadPacket()
+  byte nSend;                       // transmissions left
+  unsigned int wait;                // ticks after the packet before it is out, for pulse pairs
+};
+#endif
+
+// Everything but the storage of a register list.  All methods work on the pointers, so
+// code outside the interrupt routines can take any RegisterList<N> as a RegisterListBase.
+
+struct RegisterListBase{  
   int maxNumRegs;
   unsigned long packetsTransmitted;
   Register *reg;
@@ -42,25 +107,103 @@ struct RegisterList{
   byte nRepeat;
   byte debugcount;
   byte *speedTable;
+#ifdef COMPACT_REGISTERS
+  byte nBits;                       // of the packet in currentReg, start and end bits included
+  byte lookIndex;                   // next byte of currentReg to go into look, nBytes = checksum
+  byte look;                        // rest of the byte being sent, MSB next
+  byte lookBits;                    // bits left in look, 0 = a start or the end bit is next
+  byte checksum;
+#endif
+#ifdef ACCESSORY_QUEUE
+  Register *resumeReg;              // loco register sent before the accessory packet being sent, else NULL
+  byte accPackets;                  // loco packets since the last accessory packet
+#endif
+#ifdef REGISTER_STATS
+  RegisterStats *stats;             // one entry per Register slot, maintained by the interrupt routine
+  unsigned long statsStartTick;
+  unsigned long statsStartPackets;
+  unsigned long oneShotPackets;     // packets sent from register 0 (functions, accessories, POM)
+  void clearStats() volatile;
+  void printStats() volatile;
+#endif
   static byte idlePacket[];
   static byte resetPacket[];
   static byte bitMask[];
-  RegisterList(int);
-  byte ackdetect(unsigned int) volatile;
+  static byte sessionOpen;          // <G 1> session on the Programming Track
+  static byte sessionTurnoff;
+  static CVCacheEntry cvCache[CV_CACHE_SIZE];
+  static byte cvCacheNext;
+  static int cvCacheGet(int);
+  static void cvCachePut(int, int);
+  static AckStats ackStats;
+#ifdef ACCESSORY_QUEUE
+  static AccessoryPacket accQueue[ACCESSORY_QUEUE];   // sent between the loco packets by the main interrupt routine
+  static volatile byte accHead;                       // packet to be sent next
+  static volatile byte accCount;                      // packets waiting
+  static unsigned long accLastTick;                   // tickCounter when the last one was out
+  static void queueAccessory(byte *, int, unsigned int);
+#endif
+#ifdef ACCESSORY_STATE
+  static byte accessoryState[ACCESSORY_STATE_BYTES];   // last ACTIVATE sent with <a>, before ACCESSORIES_REVERSED
+  static void printAccessoryState(char *);
+#ifdef ACCESSORY_REFRESH
+  static byte accessoryKnown[ACCESSORY_STATE_BYTES];   // outputs that have been sent an <a> since power-up
+  static int refreshIndex;                             // last output sent again
+  static unsigned long refreshTick;
+  void refreshAccessory() volatile;
+#endif
+#endif
+  static void clearAckStats();
+  static void printAckStats();
+  RegisterListBase(int, Register *, Register **, byte *);
+  byte ackdetect() volatile;
   byte poweron() volatile;
-  unsigned int readBaseCurrent() volatile;
+  void readBaseNoise() volatile;
+  byte progTrackOn() volatile;
+  void progTrackOff(byte) volatile;
+  static void progSessionCheck();
+  static void printCV(int, int, int, int);
+  static int encodePacket(Register *, byte *, int);
   void loadPacket(int, byte *, int, int, int=0) volatile;
   void setThrottle(char *) volatile;
   void setFunction(char *) volatile;  
   void setAccessory(char *) volatile;
+  void loadAccessory(int, int, int, int, int=0) volatile;
   void writeTextPacket(char *) volatile;
+  byte verifyCVByte(int, byte) volatile;
+  int readCVBits(int) volatile;
+  int readCVValue(int, int) volatile;
   void readCV(char *) volatile;
+  void progSession(char *) volatile;
   void writeCVByte(char *) volatile;
   void writeCVBit(char *) volatile;
   void writeCVByteMain(char *) volatile;
   void writeCVBitMain(char *s) volatile;  
+#ifdef RAILCOM_RECEIVER
+  void readCVMain(char *) volatile;
+#endif
   void printPacket(int, byte *, int, int) volatile;
   void printMaxNumRegs() volatile;
 };
 
+// A register list for N packets plus the one-shot register 0.  The arrays are part of
+// the object, which is always a global, so the interrupt routines, which get the
+// RegisterList<N> itself, index them at addresses fixed at link time.
+
+template<int N>
+struct RegisterList : RegisterListBase {
+  Register regs[N+1];
+  Register *regsMap[N+1];
+  byte speeds[N+1];
+#ifdef REGISTER_STATS
+  RegisterStats statsTable[N+1];
+#endif
+  RegisterList() : RegisterListBase(N, regs, regsMap, speeds) {
+#ifdef REGISTER_STATS
+    stats=statsTable;
+    clearStats();
+#endif
+  }
+};
+
 #endif
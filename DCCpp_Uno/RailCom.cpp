@@ -0,0 +1,205 @@
+/**********************************************************************
+
+RailCom.cpp
+COPYRIGHT (c) 2020      Harald Barth
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+#include "DCCpp_Uno.h"
+#include "RailCom.h"
+#include "Comm.h"
+
+#ifdef RAILCOM_RECEIVER
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// The RailCom detector on the main track is connected to RX1 (pin 19).  During the
+// cutout the decoders send at 250 kbaud, 2 bytes in channel 1 (the address broadcast,
+// sent by every decoder that has it enabled) and up to 6 bytes in channel 2 (sent only
+// by the decoder addressed in the packet just before the cutout).  Every byte is a
+// 4-of-8 code for 6 bits of data or for ACK, NACK and BUSY.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// 4-of-8 code -> 6 bit data or RAILCOM_ACK/NACK/BUSY/INVALID
+const byte railcomDecode[256] PROGMEM = {
+  0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0x40,   // 0x00
+  0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0x33,0xFF,0xFF,0xFF,0x34,0xFF,0x35,0x36,0xFF,   // 0x10
+  0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0x3A,0xFF,0xFF,0xFF,0x3B,0xFF,0x3C,0x37,0xFF,   // 0x20
+  0xFF,0xFF,0xFF,0x3F,0xFF,0x3D,0x38,0xFF,0xFF,0x3E,0x39,0xFF,0x41,0xFF,0xFF,0xFF,   // 0x30
+  0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0x24,0xFF,0xFF,0xFF,0x23,0xFF,0x22,0x21,0xFF,   // 0x40
+  0xFF,0xFF,0xFF,0x1F,0xFF,0x1E,0x20,0xFF,0xFF,0x1D,0x1C,0xFF,0x1B,0xFF,0xFF,0xFF,   // 0x50
+  0xFF,0xFF,0xFF,0x19,0xFF,0x18,0x1A,0xFF,0xFF,0x17,0x16,0xFF,0x15,0xFF,0xFF,0xFF,   // 0x60
+  0xFF,0x25,0x14,0xFF,0x13,0xFF,0xFF,0xFF,0x32,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,   // 0x70
+  0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0x0E,0xFF,0x0D,0x0C,0xFF,   // 0x80
+  0xFF,0xFF,0xFF,0x0A,0xFF,0x09,0x0B,0xFF,0xFF,0x08,0x07,0xFF,0x06,0xFF,0xFF,0xFF,   // 0x90
+  0xFF,0xFF,0xFF,0x04,0xFF,0x03,0x05,0xFF,0xFF,0x02,0x01,0xFF,0x00,0xFF,0xFF,0xFF,   // 0xA0
+  0xFF,0x0F,0x10,0xFF,0x11,0xFF,0xFF,0xFF,0x12,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,   // 0xB0
+  0xFF,0xFF,0xFF,0xFF,0xFF,0x2B,0x30,0xFF,0xFF,0x2A,0x2F,0xFF,0x31,0xFF,0xFF,0xFF,   // 0xC0
+  0xFF,0x29,0x2E,0xFF,0x2D,0xFF,0xFF,0xFF,0x2C,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,   // 0xD0
+  0xFF,0x42,0x28,0xFF,0x27,0xFF,0xFF,0xFF,0x26,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,   // 0xE0
+  0x40,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF    /// 0xF0
+};
+
+Register *RailCom::packet=NULL;
+volatile byte RailCom::window=0;
+volatile byte RailCom::openTick;
+RailComFrame RailCom::rx;
+volatile RailComFrame RailCom::frame;
+volatile byte RailCom::frameReady=0;
+byte RailCom::adrHigh;
+byte RailCom::adrHighValid=0;
+RailComLoco RailCom::locos[RAILCOM_MAX_LOCOS];
+RailComDatagram RailCom::datagram;
+unsigned long RailCom::nFrames=0;
+unsigned long RailCom::nErrors=0;
+
+///////////////////////////////////////////////////////////////////////////////
+
+void RailCom::begin(){
+  pinMode(19,INPUT);                     // RX1
+  UCSR1A=_BV(U2X1);                      // 250 kbaud: 16MHz/8/(7+1)
+  UBRR1=7;
+  UCSR1C=_BV(UCSZ11)|_BV(UCSZ10);        // 8N1
+  UCSR1B=_BV(RXEN1)|_BV(RXCIE1);         // receiver and its interrupt on
+}
+
+ISR(USART1_RX_vect){
+  RailCom::receive();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// called from loop(), handles the last cutout if there is one
+
+void RailCom::check(){
+  RailComFrame f;
+
+  if(!frameReady)
+    return;
+  memcpy(&f,(const void *)&frame,sizeof(f));
+  frameReady=0;
+  parseFrame(&f,tickCounter);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+byte RailCom::decode(byte b){
+  return pgm_read_byte(railcomDecode+b);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Address of the mobile decoder a DCC packet was sent to, 0 for all other packets
+
+int RailCom::packetCab(const byte *b){
+  if(b[0]>=1 && b[0]<=127)               // short address
+    return b[0];
+  if(b[0]>=0xC0 && b[0]<=0xE7)           // long address
+    return ((b[0]&0x3F)<<8)+b[1];
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void RailCom::parseFrame(const RailComFrame *f, unsigned long tick){
+  byte d[RAILCOM_CH2_BYTES];
+  byte i;
+  int cab;
+
+  nFrames++;
+
+  // channel 1, 12 bits: ID and 8 bits of the address
+  if(f->n1==RAILCOM_CH1_BYTES){
+    d[0]=decode(f->ch1[0]);
+    d[1]=decode(f->ch1[1]);
+    if(d[0]<64 && d[1]<64){
+      byte id=d[0]>>2;
+      byte data=(d[0]<<6)|d[1];
+      if(id==RAILCOM_ID_ADR_HIGH){
+        adrHigh=data;
+        adrHighValid=1;
+      } else if(id==RAILCOM_ID_ADR_LOW && adrHighValid){
+        adrHighValid=0;
+        if(adrHigh & 0x80)               // 10AAAAAA: long address
+          cab=((adrHigh&0x3F)<<8)+data;
+        else
+          cab=data;
+        if(cab!=0)
+          seen(cab,tick);
+      }
+    } else {
+      nErrors++;
+      adrHighValid=0;                    // most likely two decoders talking at once
+    }
+  }
+
+  // channel 2: ACK or a datagram of 2, 3, 4 or 6 bytes from the addressed decoder
+  cab=packetCab(f->adr);
+  if(f->n2==0 || cab==0)
+    return;
+  for(i=0;i<f->n2;i++){
+    d[i]=decode(f->ch2[i]);
+    if(d[i]==RAILCOM_INVALID){
+      nErrors++;
+      return;
+    }
+  }
+  seen(cab,tick);
+  if(d[0]>=64 || f->n2<2)                // ACK, NACK or BUSY
+    return;
+  datagram.cab=cab;
+  datagram.id=d[0]>>2;
+  datagram.data=d[0]&0x03;
+  datagram.nBits=2;
+  for(i=1;i<f->n2 && d[i]<64;i++){
+    datagram.data=(datagram.data<<6)|d[i];
+    datagram.nBits+=6;
+  }
+  datagram.tick=tick;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void RailCom::seen(int cab, unsigned long tick){
+  RailComLoco *l, *oldest=locos;
+  unsigned long age, maxAge=0;
+
+  for(l=locos;l<locos+RAILCOM_MAX_LOCOS;l++){
+    if(l->cab==cab){
+      l->lastTick=tick;
+      return;
+    }
+    age=(l->cab==0) ? 0xFFFFFFFF : tick-l->lastTick;   // reuse free or oldest entry
+    if(age>=maxAge){
+      maxAge=age;
+      oldest=l;
+    }
+  }
+  oldest->cab=cab;
+  oldest->lastTick=tick;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void RailCom::show(){
+  unsigned long now=tickCounter;
+  byte n=0;
+
+  for(RailComLoco *l=locos;l<locos+RAILCOM_MAX_LOCOS;l++){
+    if(l->cab==0 || (unsigned long)(now-l->lastTick) > RAILCOM_LOCO_TIMEOUT)
+      continue;
+    INTERFACE.print(F("<l "));
+    INTERFACE.print(l->cab);
+    INTERFACE.print(F(" "));
+    INTERFACE.print((now-l->lastTick)/250);  // ms
+    INTERFACE.print(F(">"));
+    n++;
+  }
+  if(n==0)
+    INTERFACE.print(F("<X>"));
+}
+
+#endif
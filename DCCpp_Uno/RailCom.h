@@ -0,0 +1,136 @@
+/**********************************************************************
+
+RailCom.h
+COPYRIGHT (c) 2020      Harald Barth
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+#ifndef RailCom_h
+#define RailCom_h
+
+#include "Arduino.h"
+#include "Config.h"
+#include "PacketRegister.h"
+
+#ifdef RAILCOM_RECEIVER
+
+// Decoded 4-of-8 symbols that are not 6 bit data
+#define RAILCOM_ACK      0x40
+#define RAILCOM_NACK     0x41
+#define RAILCOM_BUSY     0x42
+#define RAILCOM_INVALID  0xFF
+
+// Datagram IDs (first 4 bits)
+#define RAILCOM_ID_POM       0      // channel 2: CV value, answer to a POM packet
+#define RAILCOM_ID_ADR_HIGH  1      // channel 1: high part of the address
+#define RAILCOM_ID_ADR_LOW   2      // channel 1: low part of the address
+
+#define RAILCOM_CH1_BYTES    2
+#define RAILCOM_CH2_BYTES    6
+
+// Channel 1 ends 177us after the start of the cutout and the first byte of channel 2
+// can not be complete before 233us, so everything received in the first 200us (50
+// ticks of the 4us timer 0) belongs to channel 1.
+#define RAILCOM_CH1_END      50
+
+#define RAILCOM_MAX_LOCOS    16
+#define RAILCOM_LOCO_TIMEOUT 500000UL   // ticks (2s) after which a loco is no longer on track
+#define RAILCOM_POM_TIMEOUT  25000UL    // ticks (100ms) to wait for the answer to a POM read
+
+struct RailComFrame {               // everything received in one cutout
+  byte adr[2];                      // first two bytes of the DCC packet sent before the cutout
+  byte n1;
+  byte n2;
+  byte ch1[RAILCOM_CH1_BYTES];
+  byte ch2[RAILCOM_CH2_BYTES];
+};
+
+struct RailComLoco {
+  int cab;                          // 0 = unused entry
+  unsigned long lastTick;           // tickCounter when last heard of
+};
+
+struct RailComDatagram {            // last channel 2 datagram
+  int cab;                          // sender, 0 = none yet
+  byte id;
+  byte nBits;                       // number of valid bits in data, right aligned
+  unsigned long data;
+  unsigned long tick;
+};
+
+struct RailCom{
+  static Register *packet;                     // packet before the cutout, only used by interrupts
+  static volatile byte window;
+  static volatile byte openTick;
+  static RailComFrame rx;                      // only used by interrupts
+  static volatile RailComFrame frame;
+  static volatile byte frameReady;
+  static byte adrHigh;
+  static byte adrHighValid;
+  static RailComLoco locos[RAILCOM_MAX_LOCOS];
+  static RailComDatagram datagram;
+  static unsigned long nFrames;
+  static unsigned long nErrors;
+  static void begin();
+  static inline void openWindow() __attribute__((always_inline));
+  static inline void closeWindow() __attribute__((always_inline));
+  static inline void receive() __attribute__((always_inline));
+  static void check();
+  static void show();
+  // no hardware access below, so these can be fed with made up frames
+  static byte decode(byte);
+  static int packetCab(const byte *);
+  static void parseFrame(const RailComFrame *, unsigned long);
+  static void seen(int, unsigned long);
+}; // RailCom
+
+// Called by the main track interrupt when the cutout starts
+inline void RailCom::openWindow() {
+#ifdef COMPACT_REGISTERS
+  rx.adr[0]=packet->buf[0];
+  rx.adr[1]=packet->buf[1];
+#else
+  // buf holds the bit stream: 0 b0(7-1) | b0(0) 0 b1(7-2) | b1(1-0) ... (see encodePacket)
+  rx.adr[0]=(packet->buf[0]<<1)|(packet->buf[1]>>7);
+  rx.adr[1]=(packet->buf[1]<<2)|(packet->buf[2]>>6);
+#endif
+  rx.n1=0;
+  rx.n2=0;
+  openTick=TCNT0;
+  window=1;
+}
+
+// Called by the main track interrupt when the cutout ends
+inline void RailCom::closeWindow() {
+  if(UCSR1A & _BV(RXC1))            // the receive interrupt may still be pending
+    receive();
+  window=0;
+  if(!frameReady && (rx.n1 || rx.n2)){
+    memcpy((void *)&frame,&rx,sizeof(rx));
+    frameReady=1;
+  }
+}
+
+// Called by the USART 1 receive interrupt
+inline void RailCom::receive() {
+  byte status=UCSR1A;
+  byte b=UDR1;
+
+  if(!window)
+    return;
+  if(status & (_BV(FE1)|_BV(DOR1)))
+    b=0;                            // not a 4-of-8 code, so it will be counted as error
+  if((byte)(TCNT0-openTick) < RAILCOM_CH1_END){
+    if(rx.n1<RAILCOM_CH1_BYTES)
+      rx.ch1[rx.n1++]=b;
+  } else {
+    if(rx.n2<RAILCOM_CH2_BYTES)
+      rx.ch2[rx.n2++]=b;
+  }
+}
+
+#endif
+
+#endif
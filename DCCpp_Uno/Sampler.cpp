@@ -0,0 +1,118 @@
+/**********************************************************************
+
+Sampler.cpp
+COPYRIGHT (c) 2020      Harald Barth
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+#include "DCCpp_Uno.h"
+#include "Sampler.h"
+#include "Comm.h"
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// All analog inputs are read by the ADC interrupt, nothing else may use the ADC
+// (no analogRead()) once Sampler::begin() has run.  The ADC runs free: when the
+// interrupt for one conversion comes the next one has already started with the
+// channel selected before, so the channel set now is the one of the conversion
+// after that.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+const byte Sampler::pins[SAMPLER_CHANNELS]={
+  CURRENT_MONITOR_PIN_PROG,
+  CURRENT_MONITOR_PIN_MAIN,
+  VOLTAGE_MONITOR_PIN_MAIN,
+#if MAIN_DISTRICTS > 1
+  CURRENT_MONITOR_PIN_DISTRICT2,
+#endif
+#if MAIN_DISTRICTS > 2
+  CURRENT_MONITOR_PIN_DISTRICT3,
+#endif
+};
+
+volatile unsigned int Sampler::raw[SAMPLER_CHANNELS];
+unsigned int Sampler::progRing[SAMPLER_OVERSAMPLING];
+byte Sampler::progIndex=0;
+volatile unsigned int Sampler::progSum=0;
+volatile unsigned int Sampler::progQuiescent=0xFFFF;     // falls to the first sums at once
+volatile byte Sampler::progCount=0;
+byte Sampler::pending[2];
+byte Sampler::other=SAMPLER_MAIN;
+unsigned int Sampler::vccTurns=SAMPLER_VCC_INTERVAL;    // start with a bandgap dwell
+byte Sampler::dwell=0;
+volatile unsigned int Sampler::bandgap=0;
+volatile byte Sampler::bandgapReady=0;
+int Sampler::vccPromille=1000;                            // until the first bandgap dwell is done
+
+///////////////////////////////////////////////////////////////////////////////
+
+void Sampler::begin() {
+  pending[0]=SAMPLER_PROG;
+  pending[1]=SAMPLER_MAIN;
+  select(pending[0]);
+#ifdef MUX5
+  ADCSRB &= ~(_BV(ADTS2) | _BV(ADTS1) | _BV(ADTS0));   // free running
+#else
+  ADCSRB = 0;                                          // free running
+#endif
+  ADCSRA = _BV(ADEN) | _BV(ADSC) | _BV(ADATE) | _BV(ADIE) | _BV(ADPS2) | _BV(ADPS1);  // prescaler 64
+  select(pending[1]);                                  // locked for the first conversion by now
+} // Sampler::begin()
+
+ISR(ADC_vect){
+  Sampler::interrupt();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Returns the last value of channel in 1/16 ADC counts: for the Programming Track
+// the sum of the last SAMPLER_OVERSAMPLING samples, for the others 16 times the last one.
+unsigned int Sampler::read(byte channel) {
+  unsigned int value;
+
+  noInterrupts();
+  if(channel==SAMPLER_PROG)
+    value=progSum;
+  else
+    value=raw[channel]*SAMPLER_OVERSAMPLING;
+  interrupts();
+  return value;
+} // Sampler::read()
+
+unsigned int Sampler::quiescent() {
+  unsigned int value;
+
+  noInterrupts();
+  value=progQuiescent;
+  interrupts();
+  return value;
+} // Sampler::quiescent()
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Called from loop(): turns a new bandgap average into the promille all current and
+// voltage readings must be corrected because Vref = Vcc is off. So if Vcc is 90.9%
+// this gives 1000/909=1100.  The bandgap is 1.1V, so 1.1*1024/5 = 225 counts at 5V.
+void Sampler::check() {
+  unsigned int value;
+
+  if(!bandgapReady)
+    return;
+  noInterrupts();
+  value=bandgap;
+  bandgapReady=0;
+  interrupts();
+  if(value==0)
+    return;
+  vccPromille=1000L*225*SAMPLER_OVERSAMPLING/value;
+#ifdef DEBUGPRINT
+  INTERFACE.print(F("<V "));
+  INTERFACE.print(1126400L*SAMPLER_OVERSAMPLING/value);   // Vcc in mV; 1126400 = 1.1*1024*1000
+  INTERFACE.print(F(" "));
+  INTERFACE.print(vccPromille);
+  INTERFACE.println(F(">"));
+#endif
+} // Sampler::check()
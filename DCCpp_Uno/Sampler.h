@@ -0,0 +1,155 @@
+/**********************************************************************
+
+Sampler.h
+COPYRIGHT (c) 2020      Harald Barth
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+#ifndef Sampler_h
+#define Sampler_h
+
+#include "Arduino.h"
+#include "Config.h"
+
+// Analog inputs sampled in the background, numbered in the order of Sampler::pins[]
+#define SAMPLER_PROG         0
+#define SAMPLER_MAIN         1
+#define SAMPLER_VOLTAGE      2
+#define SAMPLER_DISTRICT2    3
+#define SAMPLER_DISTRICT3    4
+
+#if MAIN_DISTRICTS > 2
+#define SAMPLER_CHANNELS     5
+#elif MAIN_DISTRICTS > 1
+#define SAMPLER_CHANNELS     4
+#else
+#define SAMPLER_CHANNELS     3
+#endif
+
+#define SAMPLER_BANDGAP      SAMPLER_CHANNELS   // the internal 1.1V reference, not in pins[]
+
+#if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+#define SAMPLER_BANDGAP_MUX  (_BV(MUX4) | _BV(MUX3) | _BV(MUX2) | _BV(MUX1))
+#else
+#define SAMPLER_BANDGAP_MUX  (_BV(MUX3) | _BV(MUX2) | _BV(MUX1))
+#endif
+
+// The ADC runs free with prescaler 64 (250kHz), 13 ADC clocks per conversion.  Every
+// second conversion is of the Programming Track current, the others take turns.
+#define SAMPLER_CONVERSION_US   52
+#define SAMPLER_PROG_PERIOD_US  (2*SAMPLER_CONVERSION_US)
+
+// The Programming Track current is the sum of the last 16 samples (14 bits, about 12
+// of them significant with the noise on the track): a new value every 104us that is
+// the average over the last 1.7ms.
+#define SAMPLER_OVERSAMPLING    16
+#define SAMPLER_WINDOW_US       (SAMPLER_OVERSAMPLING*SAMPLER_PROG_PERIOD_US)
+
+// The quiescent current follows the Programming Track current down fast (half of the
+// difference per sample) but up only one unit (1/16 ADC count) every 2^SAMPLER_QUIESCENT_RISE
+// samples, so an ACK pulse hardly moves it while a decoder settling after power on is followed.
+#define SAMPLER_QUIESCENT_RISE  1
+
+// Every SAMPLER_VCC_INTERVAL turns of the other channels (about 0.85s) the ADC converts
+// only the bandgap, SAMPLER_VCC_DWELL times back to back (572us), so it has settled for
+// the last of them, which is the only one used.  The Programming Track is not sampled
+// meanwhile.  The result goes into an exponential average with weight 1/8.  Odd, as the
+// dwell then takes the time of a whole number of Programming Track samples.
+#define SAMPLER_VCC_INTERVAL  4096
+#define SAMPLER_VCC_DWELL       11
+
+struct Sampler{
+  static const byte pins[SAMPLER_CHANNELS];
+  static volatile unsigned int raw[SAMPLER_CHANNELS];      // last conversion of each channel
+  static unsigned int progRing[SAMPLER_OVERSAMPLING];      // only used by interrupts
+  static byte progIndex;
+  static volatile unsigned int progSum;
+  static volatile unsigned int progQuiescent;
+  static volatile byte progCount;                          // number of progSum updates, wraps
+  static byte pending[2];                                  // channels of the finishing and the running conversion
+  static byte other;                                       // last channel that was not the Programming Track
+  static unsigned int vccTurns;                            // turns of the other channels since the last bandgap dwell
+  static byte dwell;                                       // bandgap conversions of the dwell still to start
+  static volatile unsigned int bandgap;                    // averaged bandgap conversion in 1/16 ADC counts, 0 = none yet
+  static volatile byte bandgapReady;
+  static int vccPromille;
+  static void begin();
+  static void check();
+  static inline void interrupt() __attribute__((always_inline));
+  static inline void select(byte) __attribute__((always_inline));
+  static unsigned int read(byte);
+  static unsigned int quiescent();
+}; // Sampler
+
+// Sets the channel of the conversion after the one running now
+inline void Sampler::select(byte channel) {
+  byte mux;
+
+  if(channel==SAMPLER_BANDGAP){
+#ifdef MUX5
+    ADCSRB &= ~_BV(MUX5);
+#endif
+    ADMUX = _BV(REFS0) | SAMPLER_BANDGAP_MUX;
+    return;
+  }
+  mux=pins[channel]-A0;
+#ifdef MUX5
+  if(mux & 0x08)
+    ADCSRB |= _BV(MUX5);
+  else
+    ADCSRB &= ~_BV(MUX5);
+#endif
+  ADMUX = _BV(REFS0) | (mux & 0x07);
+}
+
+// Called by the ADC interrupt at the end of every conversion
+inline void Sampler::interrupt() {
+  unsigned int value=ADC;
+  byte channel=pending[0];
+  byte next;
+
+  pending[0]=pending[1];
+  if(dwell){                                     // nothing but the bandgap, so the mux settles
+    dwell--;
+    next=SAMPLER_BANDGAP;
+  } else if(pending[1]!=SAMPLER_PROG){
+    next=SAMPLER_PROG;
+  } else if(++vccTurns>=SAMPLER_VCC_INTERVAL){
+    vccTurns=0;
+    dwell=SAMPLER_VCC_DWELL-1;
+    next=SAMPLER_BANDGAP;
+  } else {
+    if(++other>=SAMPLER_CHANNELS)
+      other=SAMPLER_MAIN;
+    next=other;
+  }
+  pending[1]=next;
+  select(next);
+
+  if(channel==SAMPLER_BANDGAP){
+    if(pending[0]!=SAMPLER_BANDGAP){             // last conversion of the dwell
+      if(bandgap==0)
+        bandgap=value*SAMPLER_OVERSAMPLING;
+      else
+        bandgap+=((int)(value*SAMPLER_OVERSAMPLING)-(int)bandgap)/8;
+      bandgapReady=1;
+      progCount+=(SAMPLER_VCC_DWELL-1)/2;        // the Programming Track samples skipped, for who times with them
+    }
+    return;
+  }
+  raw[channel]=value;
+  if(channel!=SAMPLER_PROG)
+    return;
+  progSum+=value-progRing[progIndex];
+  progRing[progIndex]=value;
+  progIndex=(progIndex+1)%SAMPLER_OVERSAMPLING;
+  if(progSum<progQuiescent)
+    progQuiescent=progSum+((progQuiescent-progSum)>>1);
+  else if(progSum>progQuiescent && (progCount & ((1<<SAMPLER_QUIESCENT_RISE)-1))==0)
+    progQuiescent++;
+  progCount++;
+}
+
+#endif
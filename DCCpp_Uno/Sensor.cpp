@@ -26,7 +26,7 @@ sensor definitions using the following variation of the "S" command:
 
   <S ID PIN PULLUP>:           creates a new sensor ID, with specified PIN and PULLUP
                                if sensor ID already exists, it is updated with specified PIN and PULLUP
-                               returns: <O> if successful and <X> if unsuccessful (e.g. out of memory)
+                               returns: <O> if successful and <X> if unsuccessful (e.g. table full, see MAX_SENSORS in DCCpp_Uno.h)
 
   <S ID>:                      deletes definition of sensor ID
                                returns: <O> if successful and <X> if unsuccessful (e.g. ID does not exist)
@@ -60,13 +60,14 @@ decide to ignore the <q ID> return and only react to <Q ID> triggers.
 #include "EEStore.h"
 #include <EEPROM.h>
 #include "Comm.h"
+#include "SortedTable.h"
 
 ///////////////////////////////////////////////////////////////////////////////
   
 void Sensor::check(){    
   Sensor *tt;
 
-  for(tt=firstSensor;tt!=NULL;tt=tt->nextSensor){
+  for(tt=sensors;tt<sensors+nSensors;tt++){
     tt->signal=tt->signal*(1.0-SENSOR_DECAY)+digitalRead(tt->data.pin)*SENSOR_DECAY;
     
     if(!tt->active && tt->signal<0.5){
@@ -88,22 +89,20 @@ void Sensor::check(){
 
 Sensor *Sensor::create(int snum, int pin, int pullUp, int v){
   Sensor *tt;
+  int i=SortedTable<Sensor>::find(sensors,nSensors,snum);
   
-  if(firstSensor==NULL){
-    firstSensor=(Sensor *)calloc(1,sizeof(Sensor));
-    tt=firstSensor;
-  } else if((tt=get(snum))==NULL){
-    tt=firstSensor;
-    while(tt->nextSensor!=NULL)
-      tt=tt->nextSensor;
-    tt->nextSensor=(Sensor *)calloc(1,sizeof(Sensor));
-    tt=tt->nextSensor;
-  }
-
-  if(tt==NULL){       // problem allocating memory
-    if(v==1)
-      INTERFACE.print("<X>");
-    return(tt);
+  if(i<nSensors && sensors[i].data.snum==snum){
+    tt=&sensors[i];                   // update existing entry
+  } else {
+    if(nSensors==MAX_SENSORS){            // table full
+      failures++;
+      if(v==1)
+        INTERFACE.print("<X>");
+      return(NULL);
+    }
+    tt=SortedTable<Sensor>::insert(sensors,nSensors,i);
+    if(nSensors>highWater)
+      highWater=nSensors;
   }
   
   tt->data.snum=snum;
@@ -123,28 +122,19 @@ Sensor *Sensor::create(int snum, int pin, int pullUp, int v){
 ///////////////////////////////////////////////////////////////////////////////
 
 Sensor* Sensor::get(int n){
-  Sensor *tt;
-  for(tt=firstSensor;tt!=NULL && tt->data.snum!=n;tt=tt->nextSensor);
-  return(tt); 
+  return(SortedTable<Sensor>::get(sensors,nSensors,n));
 }
 ///////////////////////////////////////////////////////////////////////////////
 
 void Sensor::remove(int n){
-  Sensor *tt,*pp;
-  
-  for(pp=tt=firstSensor;tt!=NULL && tt->data.snum!=n;pp=tt,tt=tt->nextSensor);
+  Sensor *tt=get(n);
 
   if(tt==NULL){
     INTERFACE.print("<X>");
     return;
   }
   
-  if(tt==firstSensor)
-    firstSensor=tt->nextSensor;
-  else
-    pp->nextSensor=tt->nextSensor;
-
-  free(tt);
+  SortedTable<Sensor>::remove(sensors,nSensors,tt-sensors);
 
   INTERFACE.print("<O>");
 }
@@ -154,12 +144,12 @@ void Sensor::remove(int n){
 void Sensor::show(){
   Sensor *tt;
 
-  if(firstSensor==NULL){
+  if(nSensors==0){
     INTERFACE.print("<X>");
     return;
   }
     
-  for(tt=firstSensor;tt!=NULL;tt=tt->nextSensor){
+  for(tt=sensors;tt<sensors+nSensors;tt++){
     INTERFACE.print("<Q");
     INTERFACE.print(tt->data.snum);
     INTERFACE.print(" ");
@@ -175,12 +165,12 @@ void Sensor::show(){
 void Sensor::status(){
   Sensor *tt;
 
-  if(firstSensor==NULL){
+  if(nSensors==0){
     INTERFACE.print("<X>");
     return;
   }
     
-  for(tt=firstSensor;tt!=NULL;tt=tt->nextSensor){
+  for(tt=sensors;tt<sensors+nSensors;tt++){
     INTERFACE.print(tt->active?"<Q":"<q");
     INTERFACE.print(tt->data.snum);
     INTERFACE.print(">");
@@ -230,18 +220,19 @@ void Sensor::load(){
 void Sensor::store(){
   Sensor *tt;
   
-  tt=firstSensor;
   EEStore::eeStore->data.nSensors=0;
   
-  while(tt!=NULL){
-    EEPROM.put(EEStore::pointer(),tt->data);
+  for(tt=sensors;tt<sensors+nSensors;tt++){
+    EEStore::put(EEStore::pointer(),tt->data);
     EEStore::advance(sizeof(tt->data));
-    tt=tt->nextSensor;
     EEStore::eeStore->data.nSensors++;
   }  
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-Sensor *Sensor::firstSensor=NULL;
+Sensor Sensor::sensors[MAX_SENSORS];
+int Sensor::nSensors=0;
+int Sensor::highWater=0;
+int Sensor::failures=0;
 
@@ -21,14 +21,19 @@ struct SensorData {
 };
 
 struct Sensor{
-  static Sensor *firstSensor;
+  static Sensor sensors[];           // sorted by snum, MAX_SENSORS entries
+  static int nSensors;
+  static int highWater;              // most entries ever in use
+  static int failures;               // creates refused because the table was full
   SensorData data;
   boolean active;
   float signal;
-  Sensor *nextSensor;
   static void load();
   static void store();
   static Sensor *create(int, int, int, int=0);
+  inline int key() {                 // for SortedTable
+      return data.snum;
+  }
   static Sensor* get(int);  
   static void remove(int);  
   static void show();
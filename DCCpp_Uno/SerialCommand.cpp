@@ -23,6 +23,10 @@ Part of DCC++ BASE STATION for the Arduino
 #ifdef EESTORE
 #include "EEStore.h"
 #endif
+#include "RailCom.h"
+#ifdef HISTORY
+#include "History.h"
+#endif
 #include "Comm.h"
 
 extern void *__data_end;
@@ -37,13 +41,37 @@ int over(){
 
 ///////////////////////////////////////////////////////////////////////////////
 
+// Power for all districts of the main operations track
+
+static void mainPowerOn(){
+  mainMonitor.on();
+#if MAIN_DISTRICTS > 1
+  district2Monitor.on();
+#endif
+#if MAIN_DISTRICTS > 2
+  district3Monitor.on();
+#endif
+}
+
+static void mainPowerOff(){
+  mainMonitor.off();
+#if MAIN_DISTRICTS > 1
+  district2Monitor.off();
+#endif
+#if MAIN_DISTRICTS > 2
+  district3Monitor.off();
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 char SerialCommand::commandString[MAX_COMMAND_LENGTH+1];
-volatile RegisterList *SerialCommand::mRegs;
-volatile RegisterList *SerialCommand::pRegs;
+volatile RegisterListBase *SerialCommand::mRegs;
+volatile RegisterListBase *SerialCommand::pRegs;
 
 ///////////////////////////////////////////////////////////////////////////////
 
-void SerialCommand::init(volatile RegisterList *_mRegs, volatile RegisterList *_pRegs){
+void SerialCommand::init(volatile RegisterListBase *_mRegs, volatile RegisterListBase *_pRegs){
   mRegs=_mRegs;
   pRegs=_pRegs;
   commandString[0] = '\0';
@@ -206,6 +234,24 @@ void SerialCommand::parse(char *com){
       mRegs->setAccessory(com+1);
       break;
 
+/***** SHOW THE LAST STATE SENT TO A RANGE OF ACCESSORY DECODERS  ****/    
+
+    case 'N':       // <N ADDRESS COUNT>
+/*
+ *    reads the last ACTIVATE sent with <a> (or by a turnout) to COUNT decoders from ADDRESS on.
+ *    Only available if ACCESSORY_STATE is defined in Config.h
+ *    
+ *    ADDRESS: the primary address of the first decoder (0-511)
+ *    COUNT: the number of decoders (1-512, ADDRESS+COUNT at most 512)
+ *    
+ *    returns: <n ADDRESS STATES> where STATES has one hex digit per decoder, bit 0 for subaddress 0
+ *             to bit 3 for subaddress 3 (0 if never sent), or <X> if the range is wrong
+ */
+#ifdef ACCESSORY_STATE
+      RegisterListBase::printAccessoryState(com+1);
+#endif
+      break;
+
 /***** CREATE/EDIT/REMOVE/SHOW & OPERATE A TURN-OUT  ****/    
 
     case 'T':       // <T ID THROW>
@@ -274,6 +320,26 @@ void SerialCommand::parse(char *com){
       mRegs->writeCVByteMain(com+1);
       break;      
 
+/***** READ CONFIGURATION VARIABLE BYTE FROM ENGINE DECODER ON MAIN OPERATIONS TRACK  ****/
+
+    case 'r':      // <r CAB CV CALLBACKNUM CALLBACKSUB>
+/*
+ *    reads a Configuration Variable from the decoder of an engine on the main operations track.  The decoder
+ *    must have RailCom channel 2 enabled.  Only available if RAILCOM_RECEIVER is defined in Config.h
+ *
+ *    CAB:  the short (1-127) or long (128-10293) address of the engine decoder
+ *    CV: the number of the Configuration Variable memory location in the decoder to read from (1-1024)
+ *    CALLBACKNUM: an arbitrary integer (0-32767) that is ignored by the Base Station and is simply echoed back in the output - useful for external programs that call this function
+ *    CALLBACKSUB: a second arbitrary integer (0-32767) that is ignored by the Base Station and is simply echoed back in the output - useful for external programs (e.g. DCC++ Interface) that call this function
+ *
+ *    returns: <r CALLBACKNUM|CALLBACKSUB|CV VALUE>
+ *    where VALUE is a number from 0-255 as read from the requested CV, or -1 if the decoder did not answer
+*/
+#ifdef RAILCOM_RECEIVER
+      mRegs->readCVMain(com+1);
+#endif
+      break;
+
 /***** WRITE CONFIGURATION VARIABLE BIT TO ENGINE DECODER ON MAIN OPERATIONS TRACK  ****/    
 
     case 'b':      // <b CAB CV BIT VALUE>
@@ -327,13 +393,15 @@ void SerialCommand::parse(char *com){
 
 /***** READ CONFIGURATION VARIABLE BYTE FROM ENGINE DECODER ON PROGRAMMING TRACK  ****/    
 
-    case 'R':     // <R CV CALLBACKNUM CALLBACKSUB>
+    case 'R':     // <R CV CALLBACKNUM CALLBACKSUB [GUESS]>
 /*    
  *    reads a Configuration Variable from the decoder of an engine on the programming track
  *    
  *    CV: the number of the Configuration Variable memory location in the decoder to read from (1-1024)
  *    CALLBACKNUM: an arbitrary integer (0-32767) that is ignored by the Base Station and is simply echoed back in the output - useful for external programs that call this function
  *    CALLBACKSUB: a second arbitrary integer (0-32767) that is ignored by the Base Station and is simply echoed back in the output - useful for external programs (e.g. DCC++ Interface) that call this function
+ *    GUESS: optional expected value (0-255), checked with a single byte verify before reading bit by bit.  If omitted,
+ *           the value last read or written for this CV on the programming track is used as guess
  *    
  *    returns: <r CALLBACKNUM|CALLBACKSUB|CV VALUE)
  *    where VALUE is a number from 0-255 as read from the requested CV, or -1 if read could not be verified
@@ -341,6 +409,50 @@ void SerialCommand::parse(char *com){
       pRegs->readCV(com+1);
       break;
 
+/***** PRINT ACK DETECTION STATISTICS OF THE PROGRAMMING TRACK  ****/    
+
+    case 'A':     // <A> or <A 0>
+/*    
+ *    shows how well decoders on the programming track acknowledge since the statistics were last
+ *    cleared by <A 0> or by opening a session with <G 1>
+ *    
+ *    returns: <A ACKS NOACKS FALSE MINWIDTH AVGWIDTH MAXWIDTH PEAK NOISE THRESHOLD>
+ *    where ACKS is the number of ACKs detected, NOACKS the number of verifies without ACK, FALSE the number
+ *    of current pulses rejected as ACK (spikes, too short or too long), MIN/AVG/MAXWIDTH the ACK pulse width
+ *    in us, PEAK the highest ACK current above the baseline in mA, NOISE the noise of the last baseline
+ *    measurement in mA and THRESHOLD the ACK threshold derived from it in mA
+*/    
+      {
+        int n;
+        if(sscanf(com+1,"%d",&n)==1 && n==0)
+          pRegs->clearAckStats();
+        else
+          pRegs->printAckStats();
+      }
+      break;
+
+/***** READ A RANGE OF CONFIGURATION VARIABLES / PROGRAMMING TRACK SESSION  ****/    
+
+    case 'G':     // <G 1>, <G 0> or <G FIRST LAST CALLBACKNUM CALLBACKSUB>
+/*    
+ *    <G 1> opens a programming session: the programming track is powered and the noise of its current measured
+ *    once, and all <R>, <W>, <B> and <G> commands until <G 0> reuse both instead of powering up and
+ *    waiting for the decoder to settle every time.  <G 0> closes the session and turns the power off again
+ *    if the session turned it on.  <0> or a short on the programming track end the session as well,
+ *    which is reported with <g 0>
+ *
+ *    returns: <g STATE> where STATE is 1 while a session is open, 0 otherwise
+ *    
+ *    <G FIRST LAST CALLBACKNUM CALLBACKSUB> reads CVs FIRST through LAST (1-1024) from the decoder of an
+ *    engine on the programming track, inside the open session or, if there is none, in one of its own.
+ *    The value last read or written for a CV is tried first with a single byte verify
+ *    
+ *    returns: <r CALLBACKNUM|CALLBACKSUB|CV VALUE> for each CV, as for <R>, or <X> if FIRST and LAST
+ *             are not a range within 1-1024
+*/    
+      pRegs->progSession(com+1);
+      break;
+
 /***** TURN ON POWER FROM MOTOR SHIELD TO ALL TRACKS  ****/    
 
     case '1':      // <1>
@@ -349,7 +461,7 @@ void SerialCommand::parse(char *com){
  *    
  *    returns: <p1>
  */    
-     mainMonitor.on();
+     mainPowerOn();
      progMonitor.on();
      INTERFACE.print(F("<p1>"));
      break;
@@ -358,11 +470,11 @@ void SerialCommand::parse(char *com){
 
     case '2':      // <1>
 /*
- *    enables power from the motor shield to the main operations track
+ *    enables power from the motor shield to the main operations track (all districts)
  *
  *    returns: <p1>
  */
-     mainMonitor.on();
+     mainPowerOn();
      INTERFACE.print(F("<p1 MAIN>"));
      break;
 
@@ -386,9 +498,10 @@ void SerialCommand::parse(char *com){
  *    
  *    returns: <p0>
  */
-     mainMonitor.off();
+     mainPowerOff();
      progMonitor.off();
      INTERFACE.print(F("<p0>"));
+     RegisterListBase::progSessionCheck();    // <g 0> if there was a <G 1> session
      break;
 
 /***** READ MAIN OPERATIONS TRACK CURRENT  ****/    
@@ -426,6 +539,45 @@ void SerialCommand::parse(char *com){
       INTERFACE.print(F(">"));
       break;
 
+/***** REPORT TRACK VOLTAGE AND POWER  ****/    
+
+    case 'V':     // <V>
+/*
+ *    reports the voltage on the main operations track over the last window of VOLTAGE_WINDOW samples
+ *    (see VoltageMonitor.h) and the power drawn from every track
+ *    
+ *    returns: <V MIN AVG MAX NOMINAL SAGS> followed by <V TRACK CURRENT POWER> for each track
+ *    where MIN, AVG and MAX are in mV, NOMINAL is the average voltage without sags in mV, SAGS the number
+ *    of sags since start, TRACK is MAIN, PROG, DIST2 or DIST3, CURRENT in mA and POWER in mW
+ *
+ *    Whenever the track voltage drops below VOLTAGE_SAG_PROMILLE of NOMINAL <v SAG MIN> is sent
+ *    on its own, and <v OK MIN> when it is back above VOLTAGE_OK_PROMILLE
+ */
+      mainVoltageMonitor.report();
+      break;
+
+/***** SHOW OR SUBSCRIBE TO CURRENT AND VOLTAGE HISTORY  ****/    
+
+    case 'h':     // <h> or <h N>
+/*
+ *    <h> shows the history of the main and programming track currents and the main track voltage, one entry
+ *    per HISTORY_INTERVAL current checks (see History.h), oldest first.  Only available if HISTORY is defined
+ *    in Config.h
+ *    
+ *    returns: <h MAINMIN MAINMEAN MAINMAX PROGMIN PROGMEAN PROGMAX VMIN VMEAN VMAX> for each entry
+ *             followed by <h USED SIZE INTERVAL>
+ *    where currents are in mA, voltages in mV, USED is the number of entries shown, SIZE the number
+ *    of entries kept and INTERVAL the time per entry in ms
+ *
+ *    <h N> sends the newest entry on its own every N entries from now on, <h 0> stops that
+ *
+ *    returns: <O>
+ */
+#ifdef HISTORY
+      History::parse(com+1);
+#endif
+      break;
+
 
 /***** READ STATUS OF DCC++ BASE STATION  ****/    
 
@@ -464,8 +616,9 @@ void SerialCommand::parse(char *com){
     case 'E':     // <E>
 /*
  *    stores settings for turnouts and sensors EEPROM
+ *    only the bytes that changed are written
  *    
- *    returns: <e nTurnouts nSensors nOutputs>
+ *    returns: <e nTurnouts nSensors nOutputs BYTES>, BYTES is the number of bytes written
 */
 #ifdef EESTORE     
     EEStore::store();
@@ -475,6 +628,8 @@ void SerialCommand::parse(char *com){
     INTERFACE.print(EEStore::eeStore->data.nSensors);
     INTERFACE.print(" ");
     INTERFACE.print(EEStore::eeStore->data.nOutputs);
+    INTERFACE.print(" ");
+    INTERFACE.print(EEStore::bytesWritten);
     INTERFACE.print(">");
 #endif
     break;
@@ -536,6 +691,17 @@ void SerialCommand::parse(char *com){
       bitSet(TCCR3B,CS31);
       bitClear(TCCR3B,CS30);
 
+      #if MAIN_DISTRICTS > 1
+        bitClear(TCCR4B,CS42);  // keep Timer 4 in lockstep with Timer 1
+        bitSet(TCCR4B,CS41);
+        bitClear(TCCR4B,CS40);
+      #endif
+      #if MAIN_DISTRICTS > 2
+        bitClear(TCCR5B,CS52);  // keep Timer 5 in lockstep with Timer 1
+        bitSet(TCCR5B,CS51);
+        bitClear(TCCR5B,CS50);
+      #endif
+
     #endif
 
     CLKPR=0x80;           // THIS SLOWS DOWN SYSYEM CLOCK BY FACTOR OF 256
@@ -588,8 +754,10 @@ void SerialCommand::parse(char *com){
  *     measure amount of free SRAM memory left on the Arduino based on
  *     http://playground.arduino.cc/Code/AvailableMemoryUseful 
  *     
- *     returns: <f MEM>
- *     where MEM is the number of free bytes remaining in the Arduino's SRAM
+ *     returns: <f MEM DATAEND HEAPSTART BRKVAL OVER T_USED T_HIGH T_MAX T_FAIL S_USED S_HIGH S_MAX S_FAIL O_USED O_HIGH O_MAX O_FAIL>
+ *     where MEM is the number of free bytes remaining in the Arduino's SRAM, followed by the heap
+ *     pointers and, for the turnout (T), sensor (S) and output (O) tables, the number of entries in use,
+ *     the most ever in use, the table size and the number of creates refused because the table was full
  */
       INTERFACE.print(F("<f "));
       INTERFACE.print(freeMemory());
@@ -601,9 +769,37 @@ void SerialCommand::parse(char *com){
       INTERFACE.print((int)__brkval);
       INTERFACE.print(F(" "));
       INTERFACE.print(over());
+      INTERFACE.print(F(" "));
+      INTERFACE.print(Turnout::nTurnouts); INTERFACE.print(F(" "));
+      INTERFACE.print(Turnout::highWater); INTERFACE.print(F(" "));
+      INTERFACE.print(MAX_TURNOUTS); INTERFACE.print(F(" "));
+      INTERFACE.print(Turnout::failures); INTERFACE.print(F(" "));
+      INTERFACE.print(Sensor::nSensors); INTERFACE.print(F(" "));
+      INTERFACE.print(Sensor::highWater); INTERFACE.print(F(" "));
+      INTERFACE.print(MAX_SENSORS); INTERFACE.print(F(" "));
+      INTERFACE.print(Sensor::failures); INTERFACE.print(F(" "));
+      INTERFACE.print(Output::nOutputs); INTERFACE.print(F(" "));
+      INTERFACE.print(Output::highWater); INTERFACE.print(F(" "));
+      INTERFACE.print(MAX_OUTPUTS); INTERFACE.print(F(" "));
+      INTERFACE.print(Output::failures);
       INTERFACE.print(F(">"));
       break;
 
+/***** LIST LOCOS HEARD OF ON THE MAIN OPERATIONS TRACK BY RAILCOM ****/
+
+    case 'l':     // <l>
+/*
+ *    lists the locos that sent their address in RailCom channel 1 or answered in channel 2
+ *    during the last 2 seconds.  Only available if RAILCOM_RECEIVER is defined in Config.h
+ *
+ *    returns: <l CAB AGE> for each loco, where AGE is the time in ms since it was last heard of,
+ *             or <X> if there is none
+ */
+#ifdef RAILCOM_RECEIVER
+      RailCom::show();
+#endif
+      break;
+
 /***** LISTS BIT CONTENTS OF ALL INTERNAL DCC PACKET REGISTERS  ****/        
 
     case 'L':     // <L>
@@ -622,12 +818,21 @@ void SerialCommand::parse(char *com){
       for(Register *p=mRegs->reg;p<=mRegs->maxLoadedReg;p++){
 	INTERFACE.print(F("M")); INTERFACE.print((int)(p-mRegs->reg)); INTERFACE.print(F(":\t"));
 	INTERFACE.print((int)p); INTERFACE.print(F("\t"));
+#ifdef COMPACT_REGISTERS
+	INTERFACE.print(p->nBytes & ~REGISTER_INVALID); INTERFACE.print(F("\t"));
+	for(int i=0;i< (p->nBytes & ~REGISTER_INVALID) && i<5;i++){ // This is diag code, we do not trust p->nBytes only
+	    INTERFACE.print(p->buf[i],HEX); INTERFACE.print(F("\t"));
+	}
+	INTERFACE.print(F("F_"));
+	INTERFACE.print((p->nBytes & REGISTER_INVALID) ? 1 : 0); INTERFACE.print(F("\t"));
+#else
 	INTERFACE.print(p->nBits); INTERFACE.print(F("\t"));
 	for(int i=0;i< p->nBits/8 + (p->nBits%8 ? 1 : 0 ) && i<7;i++){ // This is diag code, we do not trust p->nBits only
 	    INTERFACE.print(p->buf[i],HEX); INTERFACE.print(F("\t"));
 	}
 	INTERFACE.print(F("F_"));
 	INTERFACE.print((p->buf[6])&0x01,HEX); INTERFACE.print(F("\t"));
+#endif
 	INTERFACE.println("");
       }
       INTERFACE.println("");
@@ -641,17 +846,79 @@ void SerialCommand::parse(char *com){
       for(Register *p=pRegs->reg;p<=pRegs->maxLoadedReg;p++){
         INTERFACE.print(F("P")); INTERFACE.print((int)(p-pRegs->reg)); INTERFACE.print(F(":\t"));
         INTERFACE.print((int)p); INTERFACE.print(F("\t"));
+#ifdef COMPACT_REGISTERS
+	INTERFACE.print(p->nBytes & ~REGISTER_INVALID); INTERFACE.print(F("\t"));
+	for(int i=0;i< (p->nBytes & ~REGISTER_INVALID) && i<5;i++){ // This is diag code, we do not trust p->nBytes only
+	    INTERFACE.print(p->buf[i],HEX); INTERFACE.print(F("\t"));
+	}
+	INTERFACE.print(F("F_"));
+	INTERFACE.print((p->nBytes & REGISTER_INVALID) ? 1 : 0); INTERFACE.print(F("\t"));
+#else
 	INTERFACE.print(p->nBits); INTERFACE.print(F("\t"));
 	for(int i=0;i< p->nBits/8 + (p->nBits%8 ? 1 : 0 ) && i<7;i++){ // This is diag code, we do not trust p->nBits only
 	    INTERFACE.print(p->buf[i],HEX); INTERFACE.print(F("\t"));
 	}
 	INTERFACE.print(F("F_"));
 	INTERFACE.print((p->buf[8])&0x03,HEX); INTERFACE.print(F("\t"));
+#endif
         INTERFACE.println("");
       }
       INTERFACE.println("");
       break;
 
+/***** PRINT REFRESH STATISTICS OF MAIN OPERATIONS TRACK REGISTERS ****/
+
+    case 'U':     // <U> or <U 0>
+/*
+ *    shows how often each register in use on the main operations track has been refreshed since the
+ *    statistics were last cleared.  Only available if REGISTER_STATS is defined in Config.h
+ *
+ *    <U 0> clears the statistics and starts a new measurement
+ *
+ *    returns: <U REGISTER COUNT MIN AVG MAX> for each register in use, followed by
+ *             <U PACKETS ONESHOT USED MAX_MAIN_REGISTERS>
+ *    where COUNT is the number of transmissions of REGISTER, MIN/AVG/MAX its refresh interval in ms,
+ *    PACKETS the number of packets per second sent to the main track, ONESHOT the percentage of those
+ *    used for register 0 packets (functions, accessories, programming on main) and USED the number of
+ *    registers in use
+ */
+#ifdef REGISTER_STATS
+      {
+        int n;
+        if(sscanf(com+1,"%d",&n)==1 && n==0)
+          mRegs->clearStats();
+        else
+          mRegs->printStats();
+      }
+#endif
+      break;
+
+/***** JOIN PROGRAMMING TRACK TO MAIN OPERATIONS TRACK ****/
+
+    case 'J':     // <J> or <J STATE>
+/*
+ *    lets the programming track carry the main operations track signal so it can be used as
+ *    one more district, e.g. to drive a loco off the programming track.  Any programming track
+ *    command (<W>, <B>, <R>) switches back to service mode first.
+ *
+ *    STATE: 1 to join the programming track, 0 to go back to service mode, omit to just query
+ *
+ *    returns: <j STATE>
+ */
+      {
+        int n;
+        if(sscanf(com+1,"%d",&n)==1){
+          if(n==1)
+            joinProgTrack();
+          else if(n==0)
+            unjoinProgTrack();
+        }
+        INTERFACE.print(F("<j "));
+        INTERFACE.print(progTrackJoined!=DCC_JOIN_OFF);
+        INTERFACE.print(F(">"));
+      }
+      break;
+
 /***** PRINT MAX NUMBER OF SLOTS SUPPORTED BY MAIN REGISTER LIST ****/
 
     case '#':     // <#>
@@ -19,8 +19,8 @@ Part of DCC++ BASE STATION for the Arduino
 
 struct SerialCommand{
   static char commandString[MAX_COMMAND_LENGTH+1];
-  static volatile RegisterList *mRegs, *pRegs;
-  static void init(volatile RegisterList *, volatile RegisterList *);
+  static volatile RegisterListBase *mRegs, *pRegs;
+  static void init(volatile RegisterListBase *, volatile RegisterListBase *);
   static void parse(char *);
   static void process();
   static void printHeader();
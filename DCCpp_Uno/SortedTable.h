@@ -0,0 +1,68 @@
+/**********************************************************************
+
+SortedTable.h
+COPYRIGHT (c) 2020      Harald Barth
+
+Part of DCC++ BASE STATION for the Arduino
+
+**********************************************************************/
+
+#ifndef SortedTable_h
+#define SortedTable_h
+
+#include "Arduino.h"
+
+// The tables of turnouts, sensors and outputs are kept sorted by id, so a lookup is a
+// binary search.  T is the entry type and needs a key() that returns its id; the table
+// and the number of entries in use are handed in, they are static members of T.
+
+template<class T>
+struct SortedTable{
+  static int find(T *, int, int);
+  static T *get(T *, int, int);
+  static T *insert(T *, int &, int);
+  static void remove(T *, int &, int);
+}; // SortedTable
+
+// Index of id in table, or where it has to be inserted to keep the table sorted
+
+template<class T>
+int SortedTable<T>::find(T *table, int n, int id){
+  int lo=0, hi=n, mid;
+
+  while(lo<hi){                                 // binary search
+    mid=(lo+hi)/2;
+    if(table[mid].key()<id)
+      lo=mid+1;
+    else
+      hi=mid;
+  }
+  return(lo);
+}
+
+// The entry with id, NULL if there is none
+
+template<class T>
+T *SortedTable<T>::get(T *table, int n, int id){
+  int i=find(table,n,id);
+  return(i<n && table[i].key()==id ? &table[i] : NULL);
+}
+
+// Makes room for a cleared entry at index i, as returned by find().  The caller checks
+// that the table is not full.
+
+template<class T>
+T *SortedTable<T>::insert(T *table, int &n, int i){
+  memmove(&table[i+1],&table[i],(n-i)*sizeof(T));     // make room, keeping the table sorted
+  n++;
+  memset(&table[i],0,sizeof(T));
+  return(&table[i]);
+}
+
+template<class T>
+void SortedTable<T>::remove(T *table, int &n, int i){
+  memmove(&table[i],&table[i+1],(n-i-1)*sizeof(T));   // close the gap
+  n--;
+}
+
+#endif
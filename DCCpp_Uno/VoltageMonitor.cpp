@@ -9,35 +9,109 @@ Part of DCC++ BASE STATION for the Arduino
 
 #include "DCCpp_Uno.h"
 #include "VoltageMonitor.h"
+#include "CurrentMonitor.h"
+#include "Sampler.h"
 #include "Comm.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 
 class VoltageMonitor;
 
-VoltageMonitor::VoltageMonitor(byte sp, byte vp){
+VoltageMonitor::VoltageMonitor(byte sp, byte ch){
     this->signalpin=sp;
-    this->voltagepin=vp;
-    for(int n=0; n<vcount; n++)
-	voltage[n]=0;
-    conversionPercent=300;           // see VoltageMonitor.h
+    this->channel=ch;
+    count=0;
+    runSum=0;
+    rawMax=0;
+    vMin=vMax=vAvg=0;
+    nominal=0;
+    sag=0;
+    nSags=0;
 } // VoltageMonitor::VoltageMonitor
   
 unsigned int VoltageMonitor::read() {
-    return (unsigned int) analogRead(voltagepin);
+    return (unsigned int)(((unsigned long)Sampler::read(channel) * Sampler::vccPromille) / (1000L*SAMPLER_OVERSAMPLING));  // corrected for Vcc
+}
+
+unsigned int VoltageMonitor::toMilliVolts(unsigned int counts) {
+    return (unsigned int)((unsigned long)counts * VOLTAGE_UV_PER_COUNT / 1000);
 }
 
 void VoltageMonitor::check(){
-  voltage[v] = read();
-  v = (v+1) % vcount;
+  unsigned int v;
+
+  if (digitalRead(signalpin) == LOW) {     // no voltage to expect on an unpowered track
+    count = 0;
+    sag = 0;
+    return;
+  }
+  v = read();
+  if (count == 0) {
+    runMin = runMax = runSum = v;
+  } else {
+    if (v < runMin)
+      runMin = v;
+    if (v > runMax)
+      runMax = v;
+    runSum += v;
+  }
+  if (++count == VOLTAGE_WINDOW) {
+    window();
+    count = 0;
+  }
 } // VoltageMonitor::check  
 
+// A window is complete: publish it and look for sags against the nominal voltage
+void VoltageMonitor::window(){
+  rawMax = runMax;
+  vMin = toMilliVolts(runMin);
+  vMax = toMilliVolts(runMax);
+  vAvg = (unsigned int)((unsigned long)runSum * VOLTAGE_UV_PER_COUNT / (1000L*VOLTAGE_WINDOW));
+
+  if (nominal == 0) {
+    nominal = vAvg;
+    return;
+  }
+  if (!sag && (unsigned long)vMin * 1000 < (unsigned long)nominal * VOLTAGE_SAG_PROMILLE) {
+    sag = 1;
+    nSags++;
+    INTERFACE.print(F("<v SAG "));
+    INTERFACE.print(vMin);
+    INTERFACE.print(F(">"));
+  } else if (sag && (unsigned long)vMin * 1000 > (unsigned long)nominal * VOLTAGE_OK_PROMILLE) {
+    sag = 0;
+    INTERFACE.print(F("<v OK "));
+    INTERFACE.print(vMin);
+    INTERFACE.print(F(">"));
+  }
+  if (!sag)
+    nominal += ((long)vAvg - (long)nominal) / 8;   // follows a slowly changing supply
+} // VoltageMonitor::window
+
+// The highest sample of the last window in ADC counts, as used by <v>
 unsigned int VoltageMonitor::getVoltage() {
-    unsigned int vmax = 0;
-    for (int n=0; n<vcount; n++) {
-	if(voltage[n]>vmax) {
-	    vmax = voltage[n];
-	}
-    }
-    return vmax;
+    return rawMax;
+}
+
+unsigned int VoltageMonitor::getMilliVolts() {
+    return toMilliVolts(read());
+}
+
+// Prints <V MIN AVG MAX NOMINAL SAGS> followed by <V TRACK mA mW> for every track
+void VoltageMonitor::report() {
+    INTERFACE.print(F("<V "));
+    INTERFACE.print(vMin); INTERFACE.print(F(" "));
+    INTERFACE.print(vAvg); INTERFACE.print(F(" "));
+    INTERFACE.print(vMax); INTERFACE.print(F(" "));
+    INTERFACE.print(nominal); INTERFACE.print(F(" "));
+    INTERFACE.print(nSags);
+    INTERFACE.print(F(">"));
+    mainMonitor.printPower(vAvg);
+    progMonitor.printPower(vAvg);
+#if MAIN_DISTRICTS > 1
+    district2Monitor.printPower(vAvg);
+#endif
+#if MAIN_DISTRICTS > 2
+    district3Monitor.printPower(vAvg);
+#endif
 }
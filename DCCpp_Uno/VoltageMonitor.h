@@ -12,22 +12,37 @@ Part of DCC++ BASE STATION for the Arduino
 
 #include "Arduino.h"
 
-#define VOLTARR 10
+#define VOLTAGE_WINDOW        10    // samples (one per check()) that make one min/max/avg window
+#define VOLTAGE_UV_PER_COUNT  49776 // 4.88mV per ADC count times the voltage divider factor of 10.2
+#define VOLTAGE_SAG_PROMILLE  850   // a window minimum below 85% of the nominal voltage is a sag
+#define VOLTAGE_OK_PROMILLE   900   // which is over when the window minimum is back above 90%
+
 class VoltageMonitor {
 
-  byte vcount=VOLTARR;
   byte signalpin;
-  byte voltagepin;
-  byte v=0;
-  unsigned int voltage[VOLTARR];  // Real (corrected) current in mA, range 1mA to ~ 30A.
-  int conversionPercent;          // Percentvalue to get mA from internal 0-1023 value.
-                                  // For a factor of 3 use 300, for 1.5 use 150
+  byte channel;                   // of the Sampler
+  byte count;                     // samples in the window being collected
+  unsigned int runMin;            // of the window being collected, in ADC counts
+  unsigned int runMax;
+  unsigned int runSum;
+  unsigned int rawMax;            // of the last complete window, in ADC counts
+  unsigned int vMin;              // of the last complete window, in mV
+  unsigned int vMax;
+  unsigned int vAvg;
+  unsigned int nominal;           // average voltage without sags in mV, 0 = not known yet
+  byte sag;                       // a sag has been reported and is not over yet
+  unsigned int nSags;
+
+  static unsigned int toMilliVolts(unsigned int);
+  void window();
+
 public:
   VoltageMonitor(byte, byte);
   void check();
   unsigned int read();
   unsigned int getVoltage();
+  unsigned int getMilliVolts();
+  void report();
 };
 
 #endif
-
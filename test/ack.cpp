@@ -0,0 +1,62 @@
+// ackdetect(): the width of the current pulse a decoder answers a verify with decides if it
+// is an ACK.  A second thread stands in for the Sampler and the Programming Track
+// interrupt: it makes a new sample of the current every few microseconds and counts a
+// packet every PACKET samples, as the interrupt routine does.
+
+#include "DCCpp_Uno.h"
+#include "PacketRegister.h"
+#include "Sampler.h"
+#include <pthread.h>
+#include <unistd.h>
+
+#define PACKET 60                                     // samples per packet, about 6ms
+#define START  50                                     // sample the pulse starts at
+
+extern unsigned int progCurrent;
+
+volatile RegisterList<2> progRegs;
+volatile int running, width;                          // of the pulse in samples
+
+void *sampler(void *){
+  for(int k=0;running;k++){
+    progCurrent=(k>=START && k<START+width) ? 100 : 0;
+    Sampler::progCount++;
+    if(k%PACKET==PACKET-1)
+      progRegs.packetsTransmitted++;
+    progRegs.nextReg=NULL;                            // the packet loaded by ackdetect() is out
+    usleep(5);
+  }
+  return NULL;
+}
+
+int failed=0;
+
+void pulse(unsigned long us, byte ack){
+  pthread_t t;
+  byte found;
+
+  width=us/SAMPLER_PROG_PERIOD_US;
+  running=1;
+  pthread_create(&t,NULL,sampler,NULL);
+  found=progRegs.ackdetect();
+  running=0;
+  pthread_join(t,NULL);
+  if(found!=ack){
+    printf("%lu us pulse: ackdetect() %d, expected %d\n",us,found,ack);
+    failed++;
+  }
+}
+
+int main(){
+  RegisterListBase::ackStats.threshold=ACK_THRESHOLD_MIN;
+  pulse(6000,1);                                      // NMRA S-9.2.3: 6ms
+  pulse(ACK_MIN_WIDTH+500,1);
+  pulse(ACK_MAX_WIDTH-500,1);
+  pulse(2000,0);
+  pulse(12000,0);
+  pulse(32000,0);                                     // timed with a byte of samples, 256 of them = 26.6ms,
+  pulse(34000,0);                                     // these looked like ACKs
+  pulse(36000,0);
+  printf("8 pulses, %d failed\n",failed);
+  return failed!=0;
+}
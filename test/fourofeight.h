@@ -0,0 +1,8 @@
+// The RailCom 4-of-8 code, for the tests that make up what a decoder sends
+
+// 6 bit data -> 4-of-8 code, NMRA S-9.3.2
+const byte encode[64]={
+  0xAC,0xAA,0xA9,0xA5,0xA3,0xA6,0x9C,0x9A,0x99,0x95,0x93,0x96,0x8E,0x8D,0x8B,0xB1,
+  0xB2,0xB4,0xB8,0x74,0x72,0x6C,0x6A,0x69,0x65,0x63,0x66,0x5C,0x5A,0x59,0x55,0x53,
+  0x56,0x4E,0x4D,0x4B,0x47,0x71,0xE8,0xE4,0xE2,0xD1,0xC9,0xC5,0xD8,0xD4,0xD2,0xCA,
+  0xC6,0xCC,0x78,0x17,0x1B,0x1D,0x1E,0x2E,0x36,0x3A,0x27,0x2B,0x2D,0x35,0x39,0x33};
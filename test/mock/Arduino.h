@@ -0,0 +1,60 @@
+// Just enough of the Arduino core to build the sketch files on the host, see test/run.sh
+#ifndef MOCK_ARDUINO_H
+#define MOCK_ARDUINO_H
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+typedef uint8_t byte; typedef bool boolean; typedef uint16_t word;
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define HEX 16
+#define DEC 10
+#define A0 54
+#define A1 55
+#define A2 56
+#define A3 57
+#define A4 58
+#define A5 59
+#define A6 60
+#define A7 61
+#define PROGMEM
+#define pgm_read_byte(p) (*(const uint8_t*)(p))
+#define pgm_read_word(p) (*(const uint16_t*)(p))
+#define PSTR(s) (s)
+class __FlashStringHelper;
+#define F(s) ((const __FlashStringHelper*)(s))
+#define _BV(b) (1<<(b))
+#define bitRead(v,b) (((v)>>(b))&1)
+#define bitSet(v,b) ((v)|=(1UL<<(b)))
+#define bitClear(v,b) ((v)&=~(1UL<<(b)))
+#define bitWrite(v,b,x) ((x)?bitSet(v,b):bitClear(v,b))
+#define bit_is_set(r,b) ((r)&_BV(b))
+#define bit_is_clear(r,b) (!((r)&_BV(b)))
+#define highByte(w) ((uint8_t)((w)>>8))
+#define lowByte(w) ((uint8_t)((w)&0xff))
+#define max(a,b) ((a)>(b)?(a):(b))
+#define min(a,b) ((a)<(b)?(a):(b))
+#define constrain(x,a,b) ((x)<(a)?(a):((x)>(b)?(b):(x)))
+#define ISR(v) extern "C" void v(void); void v(void)
+#define cli() 
+#define sei()
+#define noInterrupts()
+#define interrupts()
+void pinMode(uint8_t,uint8_t); void digitalWrite(uint8_t,uint8_t); int digitalRead(uint8_t); int analogRead(uint8_t);
+void delay(unsigned long); void delayMicroseconds(unsigned int); unsigned long millis(); unsigned long micros();
+class Print { public:
+ size_t print(const __FlashStringHelper*); size_t print(const char*); size_t print(char); size_t print(int,int=DEC);
+ size_t print(unsigned int,int=DEC); size_t print(long,int=DEC); size_t print(unsigned long,int=DEC); size_t print(double,int=2);
+ size_t print(unsigned char,int=DEC);
+ size_t println(const __FlashStringHelper*); size_t println(const char* =""); size_t println(int,int=DEC); size_t println(unsigned int,int=DEC);
+ size_t println(long,int=DEC); size_t println(unsigned long,int=DEC);
+ size_t write(uint8_t); size_t write(const uint8_t*, size_t);
+};
+class HardwareSerial : public Print { public: void begin(unsigned long); int available(); int read(); void flush(); };
+extern HardwareSerial Serial;
+#include "avr/io.h"
+#endif
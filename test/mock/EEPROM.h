@@ -0,0 +1,8 @@
+#pragma once
+#include "Arduino.h"
+#include "avr/eeprom.h"
+struct EEPROMClass { uint8_t read(int a){return eeprom_read_byte((uint8_t*)(intptr_t)a);} void write(int a,uint8_t v){eeprom_write_byte((uint8_t*)(intptr_t)a,v);} void update(int a,uint8_t v){write(a,v);}
+ template<class T> T& get(int a,T&t){eeprom_read_block(&t,(void*)(intptr_t)a,sizeof(T));return t;}
+ template<class T> const T& put(int a,const T&t){eeprom_write_block(&t,(void*)(intptr_t)a,sizeof(T));return t;}
+ uint16_t length(){return E2END+1;} };
+extern EEPROMClass EEPROM;
@@ -0,0 +1,7 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+uint8_t eeprom_read_byte(const uint8_t*); void eeprom_write_byte(uint8_t*,uint8_t); void eeprom_update_byte(uint8_t*,uint8_t);
+void eeprom_read_block(void*,const void*,size_t); void eeprom_update_block(const void*,void*,size_t); void eeprom_write_block(const void*,void*,size_t);
+#define eeprom_busy_wait()
+#define E2END 4095
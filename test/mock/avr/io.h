@@ -0,0 +1,35 @@
+#pragma once
+#include <stdint.h>
+// every register as R8(name) or R16(name); stubs.cpp expands this once more to define them
+#define MOCK_REGISTERS(R8,R16) \
+  R8(TCCR0A) R8(TCCR0B) R8(OCR0A) R8(OCR0B) R8(TIMSK0) R8(TCNT0) R8(TIFR0) \
+  R8(TCCR1A) R8(TCCR1B) R8(TCCR1C) R16(OCR1A) R16(OCR1B) R16(OCR1C) R16(ICR1) R8(TIMSK1) R16(TCNT1) R8(TIFR1) \
+  R8(TCCR2A) R8(TCCR2B) R8(OCR2A) R8(OCR2B) R8(TIMSK2) R8(TCNT2) R8(TIFR2) R8(ASSR) \
+  R8(TCCR3A) R8(TCCR3B) R8(TCCR3C) R16(OCR3A) R16(OCR3B) R8(TIMSK3) R16(TCNT3) R8(TIFR3) \
+  R8(TCCR4A) R8(TCCR4B) R16(OCR4A) R16(OCR4B) R8(TIMSK4) R16(TCNT4) R8(TIFR4) \
+  R8(TCCR5A) R8(TCCR5B) R16(OCR5A) R16(OCR5B) R8(TIMSK5) R16(TCNT5) R8(TIFR5) \
+  R8(GTCCR) R8(ADMUX) R8(ADCSRA) R8(ADCSRB) R8(ADCL) R8(ADCH) R16(ADC) R8(DIDR0) R8(SREG) R8(CLKPR) \
+  R8(EECR) R8(EEDR) R16(EEAR) \
+  R8(UCSR0A) R8(UCSR0B) R8(UCSR0C) R16(UBRR0) R8(UDR0) \
+  R8(UCSR1A) R8(UCSR1B) R8(UCSR1C) R16(UBRR1) R8(UDR1) \
+  R8(UCSR2A) R8(UCSR2B) R8(UCSR2C) R16(UBRR2) R8(UDR2) \
+  R8(UCSR3A) R8(UCSR3B) R8(UCSR3C) R16(UBRR3) R8(UDR3) \
+  R8(PORTA) R8(PORTB) R8(PORTC) R8(PORTD) R8(PORTE) R8(PORTF) R8(PORTG) R8(PORTH) R8(PORTJ) R8(PORTK) R8(PORTL) \
+  R8(DDRA) R8(DDRB) R8(DDRC) R8(DDRD) R8(DDRE) R8(DDRF) R8(DDRG) R8(DDRH) R8(DDRJ) R8(DDRK) R8(DDRL) \
+  R8(PINA) R8(PINB) R8(PINC) R8(PIND) R8(PINE) R8(PINF) R8(PING) R8(PINH) R8(PINJ) R8(PINK) R8(PINL)
+#define MOCK_EXTERN8(n) extern volatile uint8_t n;
+#define MOCK_EXTERN16(n) extern volatile uint16_t n;
+MOCK_REGISTERS(MOCK_EXTERN8,MOCK_EXTERN16)
+enum { WGM00=0,WGM01=1,WGM02=3,COM0B0=4,COM0B1=5,COM0A0=6,COM0A1=7,CS00=0,CS01=1,CS02=2,OCIE0A=1,OCIE0B=2,FOC0A=7,FOC0B=6,TOIE0=0,OCF0A=1,OCF0B=2,
+WGM10=0,WGM11=1,WGM12=3,WGM13=4,COM1C0=2,COM1C1=3,COM1B0=4,COM1B1=5,COM1A0=6,COM1A1=7,CS10=0,CS11=1,CS12=2,OCIE1A=1,OCIE1B=2,OCIE1C=3,TOIE1=0,OCF1A=1,OCF1B=2,FOC1A=7,FOC1B=6,
+WGM20=0,WGM21=1,WGM22=3,COM2B0=4,COM2B1=5,COM2A0=6,COM2A1=7,CS20=0,CS21=1,CS22=2,OCIE2A=1,OCIE2B=2,TOIE2=0,OCF2A=1,OCF2B=2,FOC2A=7,FOC2B=6,
+WGM30=0,WGM31=1,WGM32=3,WGM33=4,COM3B0=4,COM3B1=5,COM3A0=6,COM3A1=7,CS30=0,CS31=1,CS32=2,OCIE3B=2,OCIE3A=1,FOC3A=7,FOC3B=6,OCF3B=2,
+WGM40=0,WGM41=1,WGM42=3,WGM43=4,COM4B0=4,COM4B1=5,CS40=0,CS41=1,CS42=2,OCIE4B=2,
+WGM50=0,WGM51=1,WGM52=3,WGM53=4,COM5B0=4,COM5B1=5,CS50=0,CS51=1,CS52=2,OCIE5B=2,
+TSM=7,PSRSYNC=0,PSRASY=1,PSR10=0,
+REFS0=6,REFS1=7,ADLAR=5,MUX0=0,MUX1=1,MUX2=2,MUX3=3,MUX4=4,MUX5=3,ADEN=7,ADSC=6,ADATE=5,ADIF=4,ADIE=3,ADPS2=2,ADPS1=1,ADPS0=0,ADTS0=0,ADTS1=1,ADTS2=2,
+EERE=0,EEPE=1,EEMPE=2,EERIE=3,
+RXC0=7,TXC0=6,UDRE0=5,RXEN0=4,TXEN0=3,UDRIE0=5,RXCIE0=7,UMSEL01=7,UMSEL00=6,UCPHA0=1,UCPOL0=0,UDORD0=2,
+RXC1=7,TXC1=6,UDRE1=5,FE1=4,DOR1=3,RXEN1=4,TXEN1=3,UDRIE1=5,RXCIE1=7,UMSEL11=7,UMSEL10=6,UCPHA1=1,UCPOL1=0,UDORD1=2,UCSZ11=2,UCSZ10=1,U2X1=1,
+RXC2=7,UDRE2=5,RXEN2=4,TXEN2=3,UDRIE2=5,UMSEL21=7,UMSEL20=6,UCPHA2=1,UCPOL2=0,UDORD2=2,TXC2=6,
+RXC3=7,UDRE3=5,RXEN3=4,TXEN3=3,UDRIE3=5,UMSEL31=7,UMSEL30=6,UCPHA3=1,UCPOL3=0,UDORD3=2,TXC3=6, DDH2=2,DDJ2=2 };
@@ -0,0 +1,5 @@
+// Forced in front of every file: the fast pin macros of digitalWriteFast.h become no-ops
+#include <Arduino.h>
+#define digitalWriteFast(P,V) do{}while(0)
+#define pinModeFast(P,V) do{}while(0)
+#define digitalReadFast(P) 0
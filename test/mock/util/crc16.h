@@ -0,0 +1,4 @@
+#pragma once
+#include <stdint.h>
+static inline uint16_t _crc16_update(uint16_t crc, uint8_t a){ crc^=a; for(int i=0;i<8;++i){ if(crc&1) crc=(crc>>1)^0xA001; else crc>>=1;} return crc; }
+static inline uint8_t _crc_ibutton_update(uint8_t crc, uint8_t data){ crc^=data; for(uint8_t i=0;i<8;i++){ if(crc&1) crc=(crc>>1)^0x8C; else crc>>=1;} return crc; }
@@ -0,0 +1,143 @@
+// RAILCOM_RECEIVER: <r CAB CV CALLBACKNUM CALLBACKSUB> against simulated decoders.  A
+// second thread stands in for the main track interrupt.  The decoders read the DCC
+// bits it makes, packet by packet, and answer a POM verify for their address in the
+// cutout after it, with the CV value in channel 2, as a real decoder does.
+
+#include "DCCpp_Uno.h"
+#include "PacketRegister.h"
+#include "DccChannel.h"
+#include "RailCom.h"
+#include "fourofeight.h"
+#include <pthread.h>
+#include <unistd.h>
+
+extern char mockOutput[];
+
+typedef DccChannel<DccTimer1,PREAMBLE_MAIN,DCC_CHANNEL_TICKCOUNT|DCC_CHANNEL_RAILCOM> MainChannel;
+volatile RegisterList<4> mainRegs;
+
+struct Decoder{
+  int cab;
+  byte cv[8];                                         // CV 1-8
+} decoders[]={{3,{3,0,0,0,0,0,0,0}},{1234,{0,11,22,33,44,55,66,77}}};
+
+// Decoder side: the DCC bits back into packets
+
+byte packet[6];
+int nPacket, nOnes, nBits, state;                     // state 0: preamble, 1: byte, 2: separator
+int answer=-1;                                        // channel 2 value for the next cutout
+
+void packetIn(){
+  byte check=0;
+  for(int i=0;i<nPacket;i++)
+    check^=packet[i];
+  if(check!=0 || nPacket<3)
+    return;
+  for(unsigned d=0;d<sizeof(decoders)/sizeof(decoders[0]);d++){
+    int cab=decoders[d].cab, n;
+    if(cab<128 && packet[0]==cab)
+      n=1;
+    else if(cab>=128 && packet[0]==(0xC0|highByte(cab)) && packet[1]==lowByte(cab))
+      n=2;
+    else
+      continue;
+    if(nPacket==n+4 && (packet[n]&0xFC)==0xE4){       // POM verify byte
+      int cv=((packet[n]&3)<<8)+packet[n+1];
+      answer=(RAILCOM_ID_POM<<8)|decoders[d].cv[cv&7];
+    }
+  }
+}
+
+void bitIn(byte bit){
+  switch(state){
+  case 0:
+    if(bit)
+      nOnes++;
+    else if(nOnes>=10){
+      state=1;
+      nPacket=0;
+      nBits=0;
+      packet[0]=0;
+    } else
+      nOnes=0;
+    break;
+  case 1:
+    packet[nPacket]=(packet[nPacket]<<1)|bit;
+    if(++nBits==8){
+      nPacket++;
+      state=2;
+    }
+    break;
+  case 2:
+    if(bit){                                          // end bit
+      packetIn();
+      nOnes=1;
+      state=0;
+    } else if(nPacket<6){
+      nBits=0;
+      packet[nPacket]=0;
+      state=1;
+    } else {
+      nOnes=0;
+      state=0;
+    }
+    break;
+  }
+}
+
+// The cutout after the packet that was just decoded
+
+void cutout(int value){
+  UCSR1A=0;
+  TCNT0=100;
+  RailCom::openWindow();
+  TCNT0+=RAILCOM_CH1_END;
+  for(int i=1;i>=0;i--){
+    UDR1=encode[(value>>(6*i))&0x3F];
+    RailCom::receive();
+  }
+  RailCom::closeWindow();
+}
+
+volatile int running=1;
+
+void *mainTrack(void *){
+  int pending=-1;
+  while(running){
+    MainChannel::interrupt(mainRegs);                 // sets RailCom::packet at the end of a packet
+    if(pending>=0){
+      cutout(pending);
+      pending=-1;
+    }
+    bitIn(OCR1A==DCC_ONE_BIT_TOTAL_DURATION_TIMER1);
+    if(answer>=0){                                    // the end bit is out, the cutout follows it
+      pending=answer;
+      answer=-1;
+    }
+    usleep(10);                                       // like the timer, loop() is much faster than a bit
+  }
+  return NULL;
+}
+
+int main(){
+  pthread_t t;
+  const char *expected[]={"<r1|2|1 3>","<r3|4|5 44>","<r5|6|1 -1>"};
+  int failed=0;
+
+  pthread_create(&t,NULL,mainTrack,NULL);
+  mainRegs.setThrottle((char *)"1 3 20 1");           // some traffic for the decoders
+  mainRegs.setThrottle((char *)"2 1234 40 1");
+  mainRegs.readCVMain((char *)"3 1 1 2");
+  mainRegs.readCVMain((char *)"1234 5 3 4");
+  mainRegs.readCVMain((char *)"55 1 5 6");            // nobody there
+  running=0;
+  pthread_join(t,NULL);
+
+  for(int i=0;i<3;i++)
+    if(strstr(mockOutput,expected[i])==NULL){
+      printf("\nmissing %s",expected[i]);
+      failed++;
+    }
+  printf("\n%d POM reads, %d failed\n",3,failed);
+  return failed!=0;
+}
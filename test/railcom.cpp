@@ -0,0 +1,97 @@
+// RAILCOM_RECEIVER: made up cutouts for packets encoded as the registers hold them.
+// The channel 2 datagram and the <l> entry have to go to the loco the packet before
+// the cutout was sent to, and channel 1 has to give the loco that sends its address.
+
+#include "DCCpp_Uno.h"
+#include "PacketRegister.h"
+#include "RailCom.h"
+#include "fourofeight.h"
+
+int failed=0;
+
+void expect(int ok, const char *what, int a, int b){
+  if(!ok){
+    printf("FAIL %s: %d, expected %d\n",what,a,b);
+    failed++;
+  }
+}
+
+// A cutout after packet b: ch1 and ch2 are 12 and 12*n bit values, -1 = nothing sent
+void cutout(byte *b, int nBytes, long ch1, long ch2, int n2){
+  static Register reg;
+
+  RegisterListBase::encodePacket(&reg,b,nBytes);
+  RailCom::packet=&reg;
+  UCSR1A=0;                                           // no receive errors, nothing pending
+  TCNT0=100;
+  RailCom::openWindow();
+  if(ch1>=0)
+    for(int i=1;i>=0;i--){
+      UDR1=encode[(ch1>>(6*i))&0x3F];
+      RailCom::receive();
+    }
+  TCNT0+=RAILCOM_CH1_END;                             // channel 2
+  for(int i=n2-1;i>=0;i--){
+    UDR1=encode[(ch2>>(6*i))&0x3F];
+    RailCom::receive();
+  }
+  RailCom::closeWindow();
+  tickCounter+=2000;
+  RailCom::check();
+}
+
+// A speed packet to cab, as setThrottle() makes it
+int speedPacket(byte *b, int cab){
+  int nB=0;
+  if(cab>127)
+    b[nB++]=highByte(cab) | 0xC0;
+  b[nB++]=lowByte(cab);
+  b[nB++]=0x3F;
+  b[nB++]=0x85;
+  return nB;
+}
+
+int seen(int cab){
+  for(int i=0;i<RAILCOM_MAX_LOCOS;i++)
+    if(RailCom::locos[i].cab==cab)
+      return 1;
+  return 0;
+}
+
+int main(){
+  const int cabs[]={1,3,100,127,128,1234,10239};
+  byte b[6];
+  int i;
+
+  for(i=0;i<64;i++)
+    expect(RailCom::decode(encode[i])==i,"decode",RailCom::decode(encode[i]),i);
+  expect(RailCom::decode(0xF0)==RAILCOM_ACK,"ACK",RailCom::decode(0xF0),RAILCOM_ACK);
+
+  for(i=0;i<7;i++){                                   // channel 2: POM answer of the addressed loco
+    int cab=cabs[i];
+    int n=speedPacket(b,cab);
+    RailCom::datagram.cab=0;
+    cutout(b,n,-1,(RAILCOM_ID_POM<<8)|(0x40+i),2);
+    expect(RailCom::datagram.cab==cab,"channel 2 cab",RailCom::datagram.cab,cab);
+    expect(RailCom::datagram.data==(unsigned long)(0x40+i),"channel 2 data",RailCom::datagram.data,0x40+i);
+    expect(seen(cab),"channel 2 <l>",0,cab);
+  }
+
+  memset(RailCom::locos,0,sizeof(RailCom::locos));
+  b[0]=0xFF; b[1]=0x00;                               // idle packet: channel 2 answer is nobody's
+  RailCom::datagram.cab=0;
+  cutout(b,2,-1,(RAILCOM_ID_POM<<8)|0x12,2);
+  expect(RailCom::datagram.cab==0,"idle packet channel 2",RailCom::datagram.cab,0);
+
+  int n=speedPacket(b,3);                             // channel 1: a long address in two cutouts
+  cutout(b,n,(RAILCOM_ID_ADR_HIGH<<8)|0x80|highByte(4711),-1,0);
+  cutout(b,n,(RAILCOM_ID_ADR_LOW<<8)|lowByte(4711),-1,0);
+  expect(seen(4711),"channel 1 long address",0,4711);
+  cutout(b,n,(RAILCOM_ID_ADR_HIGH<<8),-1,0);          // and a short one
+  cutout(b,n,(RAILCOM_ID_ADR_LOW<<8)|42,-1,0);
+  expect(seen(42),"channel 1 short address",0,42);
+  expect(!seen(3),"channel 1 only",1,0);
+
+  printf("%lu cutouts, %d failed\n",RailCom::nFrames,failed);
+  return failed!=0;
+}
@@ -0,0 +1,42 @@
+#!/bin/bash
+# Host tests for the DCC++ sketch: build each test with g++ against the mock Arduino
+# headers in test/mock and run it, once per configuration.  Usage: test/run.sh
+
+cd "$(dirname "$0")"
+SKETCH=../DCCpp_Uno
+CXX=${CXX:-g++}
+FLAGS="-std=gnu++11 -fpermissive -Wall -Werror -Imock -I$SKETCH -DARDUINO=10813 -include mock/pre.h"
+MEGA="-DARDUINO_AVR_MEGA2560 -D__AVR_ATmega2560__"
+UNO="-DARDUINO_AVR_UNO -D__AVR_ATmega328P__"
+OUT=$(mktemp -d)
+trap 'rm -rf $OUT' EXIT
+failed=0
+
+# run NAME "DEFINES" SOURCES...
+run(){
+  local name=$1 defs=$2
+  shift 2
+  if ! $CXX $FLAGS $defs "$@" $SKETCH/Sampler.cpp stubs.cpp -o $OUT/t 2>$OUT/err; then
+    head -20 $OUT/err
+    echo "FAIL $name (build)"
+    failed=1
+  elif ! $OUT/t >$OUT/log; then
+    cat $OUT/log
+    echo "FAIL $name"
+    failed=1
+  else
+    echo "ok   $name: $(tail -1 $OUT/log)"
+  fi
+}
+
+run usart "$MEGA -DDCC_GENERATOR_USART" usart.cpp $SKETCH/PacketRegister.cpp
+run usart-compact "$MEGA -DDCC_GENERATOR_USART -DCOMPACT_REGISTERS" usart.cpp $SKETCH/PacketRegister.cpp
+run railcom "$MEGA -DRAILCOM_CUTOUT -DRAILCOM_RECEIVER" railcom.cpp $SKETCH/RailCom.cpp $SKETCH/PacketRegister.cpp
+run railcom-compact "$MEGA -DRAILCOM_CUTOUT -DRAILCOM_RECEIVER -DCOMPACT_REGISTERS" railcom.cpp $SKETCH/RailCom.cpp $SKETCH/PacketRegister.cpp
+run stats "$MEGA -DREGISTER_STATS -DACCESSORY_QUEUE=8" stats.cpp $SKETCH/PacketRegister.cpp
+run sampler "$MEGA" sampler.cpp
+run ack "$MEGA -pthread" ack.cpp $SKETCH/PacketRegister.cpp
+run pom "$MEGA -DRAILCOM_CUTOUT -DRAILCOM_RECEIVER -pthread" pom.cpp $SKETCH/RailCom.cpp $SKETCH/PacketRegister.cpp
+run pom-compact "$MEGA -DRAILCOM_CUTOUT -DRAILCOM_RECEIVER -DCOMPACT_REGISTERS -pthread" pom.cpp $SKETCH/RailCom.cpp $SKETCH/PacketRegister.cpp
+
+exit $failed
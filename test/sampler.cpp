@@ -0,0 +1,49 @@
+// Sampler::interrupt(): the channel sequence of the free running ADC.  The bandgap needs
+// its conversions back to back for the mux to settle, and the Programming Track samples
+// must keep counting time.
+
+#include "DCCpp_Uno.h"
+#include "Sampler.h"
+
+#define BANDGAP (_BV(REFS0) | SAMPLER_BANDGAP_MUX)
+#define CONVERSIONS (3*2*SAMPLER_VCC_INTERVAL)
+
+int main(){
+  byte finishing, running;
+  int run=0, dwells=0, failed=0;
+
+  Sampler::begin();
+  finishing=_BV(REFS0) | (CURRENT_MONITOR_PIN_PROG-A0);
+  for(long i=0;i<CONVERSIONS;i++){
+    running=ADMUX;                                    // the next conversion starts at once
+    if(finishing==BANDGAP)
+      ADC=100+run++;                                  // tells which of the dwell was used
+    else
+      ADC=0;
+    Sampler::interrupt();
+    if(finishing==BANDGAP && running!=BANDGAP){
+      dwells++;
+      if(run!=SAMPLER_VCC_DWELL || run*SAMPLER_CONVERSION_US<500){
+        printf("%d bandgap conversions in a row\n",run);
+        failed++;
+      }
+      if(Sampler::bandgap!=(unsigned int)(100+run-1)*SAMPLER_OVERSAMPLING){
+        printf("bandgap %u is not the last conversion of the dwell\n",Sampler::bandgap);
+        failed++;
+      }
+      Sampler::bandgap=0;
+      run=0;
+    }
+    finishing=running;
+  }
+  if(dwells!=3){
+    printf("%d dwells\n",dwells);
+    failed++;
+  }
+  if((byte)(CONVERSIONS/2-Sampler::progCount)>1){     // the dwells are counted as samples
+    printf("%u Programming Track samples in %d conversions\n",Sampler::progCount,CONVERSIONS);
+    failed++;
+  }
+  printf("%d conversions, %d dwells, %d failed\n",CONVERSIONS,dwells,failed);
+  return failed!=0;
+}
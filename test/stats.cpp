@@ -0,0 +1,57 @@
+// REGISTER_STATS: <U> after registers loaded at different times, and the packet rate
+// after more packets than packets*1000 has room for on the AVR (unsigned long is 64 bits
+// here, so this only checks the result, not the overflow).
+
+#include "DCCpp_Uno.h"
+#include "PacketRegister.h"
+#include "DccChannel.h"
+
+extern char mockOutput[];
+
+volatile RegisterList<4> mainRegs;
+
+typedef DccChannel<DccTimer1,PREAMBLE_MAIN,DCC_CHANNEL_TICKCOUNT> MainChannel;
+
+void load(const char *s){
+  mainRegs.setThrottle((char *)s);
+  while(mainRegs.nextReg!=NULL)
+    MainChannel::interrupt(mainRegs);
+}
+
+void run(long bits){
+  for(long i=0;i<bits;i++)
+    MainChannel::interrupt(mainRegs);
+}
+
+int main(){
+  int failed=0, n=0;
+  unsigned long reg, count, min, avg, max, rate;
+  char *p;
+
+  mainRegs.clearStats();
+  load("1 3 50 1");
+  load("2 1234 10 0");
+  run(20000);
+  load("3 44 0 1");                                   // refreshed for the second half only
+  run(20000);
+  mainRegs.packetsTransmitted+=5000000;               // and now as if 1000s went by
+  mainRegs.statsStartTick=tickCounter-1000UL*1000*250;
+  mainRegs.printStats();
+
+  for(p=strstr(mockOutput,"<U");p!=NULL;p=strstr(p+1,"<U")){
+    if(sscanf(p,"<U%lu %lu %lu %lu %lu>",&reg,&count,&min,&avg,&max)==5){
+      n++;
+      if(count<100 || avg<min || avg>max){
+        printf("\nregister %lu: %lu refreshes %lu/%lu/%lu ms",reg,count,min,avg,max);
+        failed++;
+      }
+    } else if(sscanf(p,"<U%lu",&rate)==1 && (rate<5000 || rate>5100)){
+      printf("\n%lu packets/s",rate);
+      failed++;
+    }
+  }
+  if(n!=3)
+    failed++;
+  printf("\n%d registers, %d failed\n",n,failed);
+  return failed!=0;
+}
@@ -0,0 +1,73 @@
+// Definitions the sketch files expect from the Arduino core and from the modules
+// a test does not link.  Output goes to stdout.
+
+#include "Arduino.h"
+#include <stdarg.h>
+#include "DCCpp_Uno.h"
+#include "Sampler.h"
+#include "CurrentMonitor.h"
+
+#define MOCK_DEFINE8(n) volatile uint8_t n;
+#define MOCK_DEFINE16(n) volatile uint16_t n;
+MOCK_REGISTERS(MOCK_DEFINE8,MOCK_DEFINE16)
+
+HardwareSerial Serial;
+
+// Everything printed goes to stdout and, for the tests to look at, to mockOutput
+char mockOutput[4096];
+int mockOutputLength=0;
+
+size_t out(const char *format, ...){
+  char b[64];
+  va_list a;
+  va_start(a,format);
+  int n=vsnprintf(b,sizeof(b),format,a);
+  va_end(a);
+  if(mockOutputLength+n<(int)sizeof(mockOutput)){
+    memcpy(mockOutput+mockOutputLength,b,n+1);
+    mockOutputLength+=n;
+  }
+  return fputs(b,stdout)>=0 ? n : 0;
+}
+
+size_t Print::print(const __FlashStringHelper *s){ return out("%s",(const char *)s); }
+size_t Print::print(const char *s){ return out("%s",s); }
+size_t Print::print(char c){ return out("%c",c); }
+size_t Print::print(int v, int b){ return out(b==HEX ? "%X" : "%d",v); }
+size_t Print::print(unsigned int v, int b){ return out(b==HEX ? "%X" : "%u",v); }
+size_t Print::print(long v, int b){ return out(b==HEX ? "%lX" : "%ld",v); }
+size_t Print::print(unsigned long v, int b){ return out(b==HEX ? "%lX" : "%lu",v); }
+size_t Print::print(unsigned char v, int b){ return out(b==HEX ? "%X" : "%u",v); }
+size_t Print::print(double v, int d){ return out("%.*f",d,v); }
+size_t Print::println(const __FlashStringHelper *s){ return out("%s\n",(const char *)s); }
+size_t Print::println(const char *s){ return out("%s\n",s); }
+size_t Print::println(int v, int){ return out("%d\n",v); }
+size_t Print::println(unsigned int v, int){ return out("%u\n",v); }
+size_t Print::println(long v, int){ return out("%ld\n",v); }
+size_t Print::println(unsigned long v, int){ return out("%lu\n",v); }
+size_t Print::write(uint8_t c){ return out("%c",c); }
+size_t Print::write(const uint8_t *b, size_t n){ return out("%.*s",(int)n,(const char *)b); }
+void HardwareSerial::begin(unsigned long){}
+int HardwareSerial::available(){ return 0; }
+int HardwareSerial::read(){ return -1; }
+void HardwareSerial::flush(){}
+
+void pinMode(uint8_t, uint8_t){}
+void digitalWrite(uint8_t, uint8_t){}
+int digitalRead(uint8_t){ return HIGH; }
+int analogRead(uint8_t){ return 0; }
+void delay(unsigned long){}
+void delayMicroseconds(unsigned int){}
+// No millis() and micros(): timer0 makes the Programming Track signal on the Uno, so the
+// sketch times with tickCounter and Sampler::progCount.  A call does not link here.
+
+volatile unsigned long tickCounter;
+volatile byte progTrackJoined;
+void unjoinProgTrack(){}
+
+// The programming track current, set by the test
+unsigned int progCurrent;
+CurrentMonitor::CurrentMonitor(byte, byte, int, const char *){}
+unsigned int CurrentMonitor::read(){ return progCurrent; }
+unsigned int CurrentMonitor::quiescent(){ return 0; }
+CurrentMonitor progMonitor(0,0,0,"");
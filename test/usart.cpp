@@ -0,0 +1,86 @@
+// DCC_GENERATOR_USART: the bits shifted out by DccUsartChannel must be the DCC bits
+// DccChannel sends with timer 1 for the same registers, with 58us halves for a ONE
+// and 116us halves for a ZERO (the timer makes 100us, both are within the 95-9900us
+// NMRA S-9.1 allows for a ZERO half).
+
+#include "DCCpp_Uno.h"
+#include "PacketRegister.h"
+#include "DccChannel.h"
+
+volatile RegisterList<4> timerRegs;
+volatile RegisterList<4> usartRegs;
+byte timerBits[4000], spiBytes[1200];
+int nTimer=0, nSpi=0;
+
+typedef DccChannel<DccTimer1,PREAMBLE_MAIN,DCC_CHANNEL_TICKCOUNT> TimerChannel;
+typedef DccUsartChannel<DccUsart2,PREAMBLE_MAIN,0> UsartChannel;
+
+// One interrupt of each, everything sent is recorded from the start
+
+void timerInterrupt(){
+  TimerChannel::interrupt(timerRegs);
+  timerBits[nTimer++]=(OCR1A==DCC_ONE_BIT_TOTAL_DURATION_TIMER1);
+}
+
+void usartInterrupt(){
+  UsartChannel::interrupt(usartRegs);
+  spiBytes[nSpi++]=UDR2;
+}
+
+// The same packets into both lists; loadPacket() waits until the interrupt routine has
+// taken the previous one, so it runs until it has.
+const char *throttles[]={"1 3 50 1","2 1234 10 0","3 44 0 1"};
+
+void load(){
+  for(int i=0;i<3;i++){
+    timerRegs.setThrottle((char *)throttles[i]);
+    while(timerRegs.nextReg!=NULL)
+      timerInterrupt();
+    usartRegs.setThrottle((char *)throttles[i]);
+    while(usartRegs.nextReg!=NULL)
+      usartInterrupt();
+  }
+}
+
+int main(){
+  static byte usartBits[5000], halves[10000];
+  int nUsart=0, nHalves=0, bad=0;
+
+  load();
+
+  while(nTimer<4000)
+    timerInterrupt();
+  while(nSpi<1200)
+    usartInterrupt();
+
+  byte level=1;                                       // SPI units are sent MSB first
+  int run=0;
+  for(int i=0;i<nSpi;i++){
+    for(int b=7;b>=0;b--){
+      byte u=(spiBytes[i]>>b)&1;
+      if(u!=level && run>0){
+        halves[nHalves++]=run;
+        run=0;
+      }
+      level=u;
+      run++;
+    }
+  }
+
+  for(int i=0;i+1<nHalves;i+=2){                      // units: 1+1 is a ONE, 2+2 a ZERO
+    if(halves[i]!=halves[i+1] || (halves[i]!=1 && halves[i]!=2)){
+      printf("unequal or wrong halves %d %d at DCC bit %d\n",halves[i],halves[i+1],i/2);
+      return 1;
+    }
+    usartBits[nUsart++]=(halves[i]==1);
+  }
+
+  int n=min(nTimer,nUsart), zeros=0;
+  for(int i=0;i<n;i++){
+    if(timerBits[i]!=usartBits[i])
+      bad++;
+    zeros+=!timerBits[i];
+  }
+  printf("\n%d DCC bits (%d ZEROs) compared, %d differ\n",n,zeros,bad);
+  return bad!=0 || n<3000 || zeros<500;
+}